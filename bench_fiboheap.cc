@@ -0,0 +1,783 @@
+/**
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Benchmarks, run all of them or the ones named on the command line:
+ * g++ -O2 -std=c++20 bench_fiboheap.cc -o bf && ./bf [coro] [graph] [des] [pop] [hugepage] [bulk] [clone] [erase] [persistent] [soft] [adaptive] [trace] [tuple] [batch] ...
+ * Add -DFIBOHEAP_PREFETCH to compare the prefetching build on pop.
+ */
+
+#include "fiboheap.h"
+#include "fiboadaptive.h"
+#include "fibocoro.h"
+#include "fibograph.h"
+#include "fibohugepage.h"
+#include "fiboparallel.h"
+#include "fibopersistent.h"
+#include "fibosoft.h"
+#include "fibotrace.h"
+#include "fibotuple.h"
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+double seconds_since(bench_clock::time_point start) {
+	return chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+void report(const string& name, double ops, double secs) {
+	cout << name << ": " << ops / secs / 1e6 << " Mops/s (" << secs << " s)" << endl;
+}
+
+/*
+ * coroutine context switches, FibScheduler against a FIFO executor.
+ */
+struct fifo_scheduler {
+	struct promise_type;
+	typedef coroutine_handle<promise_type> handle;
+	struct task {
+		using promise_type = fifo_scheduler::promise_type;
+		handle h;
+	};
+	struct promise_type {
+		task get_return_object() { return task{handle::from_promise(*this)}; }
+		suspend_always initial_suspend() noexcept { return {}; }
+		suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { terminate(); }
+	};
+	struct yield_awaiter {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(handle h) { sched->ready.push_back(h); }
+		void await_resume() const noexcept {}
+		fifo_scheduler* sched;
+	};
+	yield_awaiter yield(int) { return yield_awaiter{this}; }
+	void spawn(task t, int) { ready.push_back(t.h); }
+	void run() {
+		while(!ready.empty()) {
+			handle h = ready.front();
+			ready.pop_front();
+			h.resume();
+			if(h.done())
+				h.destroy();
+		}
+	}
+	deque<handle> ready;
+};
+
+template<class Scheduler>
+typename Scheduler::task yielder(Scheduler& s, int id, int yields, long& switches) {
+	for(int i = 0; i < yields; ++i) {
+		++switches;
+		co_await s.yield((id + i) % 64);
+	}
+}
+
+template<class Scheduler>
+double bench_switches(int tasks, int yields) {
+	Scheduler s;
+	long switches = 0;
+	for(int t = 0; t < tasks; ++t)
+		s.spawn(yielder(s, t, yields, switches), t % 64);
+	auto start = bench_clock::now();
+	s.run();
+	double secs = seconds_since(start);
+	return switches / secs;
+}
+
+void bench_coro() {
+	const int tasks = 10000, yields = 100;
+	cout << "coro: " << tasks << " coroutines x " << yields << " yields" << endl;
+	cout << "  FibScheduler: " << bench_switches<FibScheduler<>>(tasks, yields) / 1e6 << " M switches/s" << endl;
+	cout << "  FIFO:         " << bench_switches<fifo_scheduler>(tasks, yields) / 1e6 << " M switches/s" << endl;
+}
+
+/*
+ * Prim and bidirectional Dijkstra, FibHeap handles against std::priority_queue
+ * with lazy deletion.
+ */
+typedef pair<long, uint32_t> graph_item;
+typedef priority_queue<graph_item, vector<graph_item>, greater<graph_item>> lazy_queue;
+
+long lazy_prim(const FibCsrGraph<long>& g) {
+	vector<char> done(g.vertices(), 0);
+	long total = 0;
+	lazy_queue pq;
+	for(uint32_t root = 0; root < g.vertices(); ++root) {
+		if(done[root])
+			continue;
+		pq.push(graph_item(0, root));
+		while(!pq.empty()) {
+			graph_item it = pq.top();
+			pq.pop();
+			if(done[it.second])
+				continue;
+			done[it.second] = 1;
+			total += it.first;
+			for(size_t i = g.offsets[it.second]; i < g.offsets[it.second + 1]; ++i)
+				if(!done[g.targets[i]])
+					pq.push(graph_item(g.weights[i], g.targets[i]));
+		}
+	}
+	return total;
+}
+
+long lazy_bidirectional_dijkstra(const FibCsrGraph<long>& g, const FibCsrGraph<long>& rg, uint32_t s, uint32_t t) {
+	const long inf = numeric_limits<long>::max();
+	vector<long> dist[2] = { vector<long>(g.vertices(), inf), vector<long>(g.vertices(), inf) };
+	vector<char> settled[2] = { vector<char>(g.vertices(), 0), vector<char>(g.vertices(), 0) };
+	const FibCsrGraph<long>* graphs[2] = { &g, &rg };
+	lazy_queue pq[2];
+	dist[0][s] = dist[1][t] = 0;
+	pq[0].push(graph_item(0, s));
+	pq[1].push(graph_item(0, t));
+	long best = s == t ? 0 : inf;
+	while(!pq[0].empty() && !pq[1].empty()) {
+		if(best != inf && pq[0].top().first + pq[1].top().first >= best)
+			break;
+		int a = pq[0].size() <= pq[1].size() ? 0 : 1;
+		graph_item it = pq[a].top();
+		pq[a].pop();
+		if(settled[a][it.second])
+			continue;
+		settled[a][it.second] = 1;
+		const FibCsrGraph<long>& ga = *graphs[a];
+		for(size_t i = ga.offsets[it.second]; i < ga.offsets[it.second + 1]; ++i) {
+			uint32_t v = ga.targets[i];
+			long d = it.first + ga.weights[i];
+			if(d < dist[a][v]) {
+				dist[a][v] = d;
+				pq[a].push(graph_item(d, v));
+			}
+			if(dist[1 - a][v] != inf && dist[a][v] + dist[1 - a][v] < best)
+				best = dist[a][v] + dist[1 - a][v];
+		}
+	}
+	return best;
+}
+
+void bench_graph() {
+	const uint32_t nv = 200000, ne = 2000000, queries = 200;
+	vector<FibCsrGraph<long>::Edge> edges;
+	for(uint32_t i = 0; i < ne; ++i)
+		edges.push_back(FibCsrGraph<long>::Edge(rand() % nv, rand() % nv, rand() % 1000));
+	auto ug = FibCsrGraph<long>::from_edges(nv, edges, true);
+	auto g = FibCsrGraph<long>::from_edges(nv, edges);
+	auto rg = g.reversed();
+	cout << "graph: " << nv << " vertices, " << ne << " edges" << endl;
+
+	vector<uint32_t> parent;
+	auto start = bench_clock::now();
+	long w1 = fib_prim_mst(ug, parent);
+	double t1 = seconds_since(start);
+	start = bench_clock::now();
+	long w2 = lazy_prim(ug);
+	double t2 = seconds_since(start);
+	cout << "  prim FibHeap: " << t1 << " s, lazy priority_queue: " << t2 << " s" << (w1 == w2 ? "" : " MISMATCH") << endl;
+
+	vector<pair<uint32_t, uint32_t>> pairs;
+	for(uint32_t i = 0; i < queries; ++i)
+		pairs.push_back({ rand() % nv, rand() % nv });
+	long sum1 = 0, sum2 = 0;
+	start = bench_clock::now();
+	for(auto& p : pairs)
+		sum1 += fib_bidirectional_dijkstra(g, rg, p.first, p.second);
+	t1 = seconds_since(start);
+	start = bench_clock::now();
+	for(auto& p : pairs)
+		sum2 += lazy_bidirectional_dijkstra(g, rg, p.first, p.second);
+	t2 = seconds_since(start);
+	cout << "  bidirectional dijkstra x" << queries << " FibHeap: " << t1 << " s, lazy priority_queue: " << t2 << " s" << (sum1 == sum2 ? "" : " MISMATCH") << endl;
+}
+
+/*
+ * discrete-event simulation with many equal timestamps: stable FibHeap against
+ * a FibHeap keyed by (time, sequence) pairs.
+ */
+template<class Heap, class MakeKey, class Time>
+double run_des(Heap& fh, MakeKey make_key, Time time_of, long events) {
+	long seq = 0;
+	for(int i = 0; i < 100000; ++i)
+		fh.push(make_key(rand() % 100, seq++));
+	auto start = bench_clock::now();
+	for(long e = 0; e < events; ++e) {
+		long now = time_of(fh.top());
+		fh.pop();
+		fh.push(make_key(now + rand() % 8, seq++));
+	}
+	return events / seconds_since(start);
+}
+
+void bench_des() {
+	const long events = 3000000;
+	FibHeap<long, less<long>, true> stable;
+	FibHeap<pair<long, long>> paired;
+	double r1 = run_des(stable, [](long t, long) { return t; }, [](long t) { return t; }, events);
+	double r2 = run_des(paired, [](long t, long s) { return make_pair(t, s); }, [](const pair<long, long>& k) { return k.first; }, events);
+	cout << "des: " << events << " events, 100000 pending" << endl;
+	cout << "  stable FibHeap:      " << r1 / 1e6 << " M events/s" << endl;
+	cout << "  (time, seq) FibHeap: " << r2 / 1e6 << " M events/s" << endl;
+}
+
+/*
+ * pops and teardown on heaps well beyond the last level cache, where the
+ * pointer walks of extract_min, consolidate and delete_fibnodes stall on memory.
+ */
+void bench_pop() {
+#ifdef FIBOHEAP_PREFETCH
+	cout << "pop (prefetch distance " << FIBOHEAP_PREFETCH_DISTANCE << ")" << endl;
+#else
+	cout << "pop (no prefetch)" << endl;
+#endif
+	const long pops = 1000000;
+	for(long n : { 1000000L, 10000000L, 30000000L }) {
+		FibHeap<long> fh;
+		mt19937_64 rng(n);
+		for(long i = 0; i < n; ++i)
+			fh.push(rng() % (n * 4));
+		auto start = bench_clock::now();
+		fh.pop();
+		double first = seconds_since(start);
+		start = bench_clock::now();
+		for(long i = 0; i < pops; ++i) {
+			// keep the size steady, so that the new roots are consolidated in.
+			fh.pop();
+			fh.push(fh.top() + rng() % (n * 4));
+		}
+		double steady = seconds_since(start);
+		start = bench_clock::now();
+		fh.clear();
+		double teardown = seconds_since(start);
+		cout << "  n=" << n << ": first pop " << first << " s, " << pops / steady / 1e6 << " M pop+push/s, teardown " << teardown << " s" << endl;
+	}
+}
+
+/*
+ * counts data TLB load misses of this thread between start() and stop(),
+ * or -1 where perf events are unavailable.
+ */
+struct dtlb_counter {
+	dtlb_counter() {
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+	~dtlb_counter() {
+		if(fd >= 0)
+			close(fd);
+	}
+	void start() {
+#ifdef __linux__
+		if(fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+	long stop() {
+		long long count = -1;
+#ifdef __linux__
+		if(fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if(read(fd, &count, sizeof(count)) != sizeof(count))
+				count = -1;
+		}
+#endif
+		return count;
+	}
+	int fd = -1;
+};
+
+/*
+ * pop latency and dTLB misses with nodes from new against 2 MiB huge page slabs.
+ */
+template<class Heap>
+void run_hugepage(const string& name, Heap& fh, long n) {
+	const long pops = 1000000;
+	mt19937_64 rng(n);
+	for(long i = 0; i < n; ++i)
+		fh.push(rng() % (n * 4));
+	dtlb_counter tlb;
+	tlb.start();
+	auto start = bench_clock::now();
+	fh.pop();
+	double first = seconds_since(start);
+	long first_misses = tlb.stop();
+	tlb.start();
+	start = bench_clock::now();
+	for(long i = 0; i < pops; ++i) {
+		fh.pop();
+		fh.push(fh.top() + rng() % (n * 4));
+	}
+	double steady = seconds_since(start);
+	long steady_misses = tlb.stop();
+	cout << "  " << name << " n=" << n << ": first pop " << first << " s, " << steady / pops * 1e9 << " ns per pop+push";
+	if(first_misses >= 0)
+		cout << ", dTLB misses: " << first_misses << " first pop, " << steady_misses / double(pops) << " per pop+push";
+	cout << endl;
+}
+
+void bench_hugepage() {
+	cout << "hugepage (dTLB misses need perf events)" << endl;
+	for(long n : { 10000000L, 30000000L }) {
+		{
+			FibHeap<long> fh;
+			run_hugepage("new      ", fh, n);
+		}
+#ifdef __linux__
+		// merge the freed nodes now, not in the next large malloc inside a timed pop.
+		malloc_trim(0);
+#endif
+		{
+			FibHugePageHeap<long> fh;
+			run_hugepage("hugepage ", fh, n);
+		}
+	}
+}
+
+/*
+ * first pop after a bulk load, sequential against parallel consolidation.
+ */
+double first_pop(long n, size_t threshold) {
+	FibParallelHeap<long> fh;
+	fh.set_parallel_consolidate(threshold);
+	mt19937_64 rng(n);
+	for(long i = 0; i < n; ++i)
+		fh.push(rng() % (n * 4));
+	auto start = bench_clock::now();
+	fh.pop();
+	return seconds_since(start);
+}
+
+void bench_bulk() {
+	cout << "bulk (" << thread::hardware_concurrency() << " hardware threads)" << endl;
+	for(long n : { 1000000L, 10000000L }) {
+		// the first heap gets fresh pages, the next ones reuse freed nodes.
+		first_pop(n, 0);
+		double t1 = first_pop(n, 0);
+		double t2 = first_pop(n, 1);
+		cout << "  n=" << n << ": first pop sequential " << t1 << " s, parallel " << t2 << " s" << endl;
+	}
+}
+
+/*
+ * forking a heap state: structural copy against slab memcpy.
+ */
+template<class Heap>
+double clone_rate(long n, int copies) {
+	Heap fh;
+	mt19937_64 rng(n);
+	for(long i = 0; i < n; ++i)
+		fh.push(rng() % (n * 4));
+	fh.pop();
+	auto start = bench_clock::now();
+	size_t check = 0;
+	for(int c = 0; c < copies; ++c) {
+		Heap copy(fh);
+		check += copy.size();
+	}
+	double secs = seconds_since(start);
+	return check == size_t(copies) * fh.size() ? copies / secs : 0;
+}
+
+void bench_clone() {
+	cout << "clone" << endl;
+	for(long n : { 10000L, 1000000L }) {
+		int copies = n < 100000 ? 2000 : 20;
+		cout << "  n=" << n << ": structural " << clone_rate<FibHeap<long>>(n, copies)
+		     << " copies/s, huge page slabs " << clone_rate<FibHugePageHeap<long>>(n, copies) << " copies/s" << endl;
+	}
+}
+
+/*
+ * evicting one tenant in ten from a queue then popping: one remove_fibnode per
+ * node against erase_if.
+ */
+double evict(long n, bool bulk) {
+	FibQueue<long> fq;
+	mt19937_64 rng(n);
+	for(long i = 0; i < n; ++i)
+		fq.push(rng() % (n * 4), reinterpret_cast<void*>(i % 10));
+	fq.pop();
+	auto evicted = [](FibQueue<long>::Node* x) { return x->payload == reinterpret_cast<void*>(3); };
+	auto start = bench_clock::now();
+	size_t erased = 0;
+	if(bulk)
+		erased = fq.erase_if(evicted);
+	else {
+		vector<FibQueue<long>::Node*> tenant;
+		fq.for_each_node([&](FibQueue<long>::Node* x) {
+			if(evicted(x))
+				tenant.push_back(x);
+		});
+		for(FibQueue<long>::Node* x : tenant)
+			fq.remove_fibnode(x);
+		erased = tenant.size();
+	}
+	// the removals leave roots behind, that the next pop consolidates.
+	fq.pop();
+	double secs = seconds_since(start);
+	return fq.size() == size_t(n - 2) - erased ? secs : -1;
+}
+
+void bench_erase() {
+	cout << "erase" << endl;
+	for(long n : { 100000L, 1000000L }) {
+		double t1 = evict(n, false);
+		double t2 = evict(n, true);
+		cout << "  n=" << n << ": remove_fibnode " << t1 << " s, erase_if " << t2 << " s" << endl;
+	}
+}
+
+/*
+ * branch-and-bound forking: each branch copies its parent's frontier, then
+ * expands it with a few pushes and pops.
+ */
+template<class Heap, class Step>
+double fork_rate(long n, int branches, Step step) {
+	mt19937_64 rng(n);
+	Heap root;
+	for(long i = 0; i < n; ++i)
+		root = step(root, rng, true);
+	auto start = bench_clock::now();
+	size_t check = 0;
+	for(int b = 0; b < branches; ++b) {
+		Heap branch(root);
+		for(int i = 0; i < 10; ++i)
+			branch = step(branch, rng, i % 2);
+		check += branch.size();
+	}
+	double secs = seconds_since(start);
+	return check == size_t(branches) * root.size() ? branches / secs : 0;
+}
+
+void bench_persistent() {
+	cout << "persistent" << endl;
+	auto fib_step = [](FibHeap<long>& h, mt19937_64& rng, bool push) -> FibHeap<long>& {
+		if(push)
+			h.push(rng() % 1000000);
+		else
+			h.pop();
+		return h;
+	};
+	auto persistent_step = [](const FibPersistentHeap<long>& h, mt19937_64& rng, bool push) {
+		return push ? h.push(rng() % 1000000) : h.pop();
+	};
+	for(long n : { 1000L, 100000L }) {
+		int branches = n < 10000 ? 20000 : 200;
+		cout << "  n=" << n << ": FibHeap copy " << fork_rate<FibHeap<long>>(n, branches, fib_step)
+		     << " branches/s, persistent " << fork_rate<FibPersistentHeap<long>>(n, branches, persistent_step) << " branches/s" << endl;
+	}
+}
+
+/*
+ * draining a bulk load: exact pops against the soft heap, with the share of
+ * the first 1% pops that are among the 1% smallest keys.
+ */
+void bench_soft() {
+	cout << "soft" << endl;
+	const long n = 1000000;
+	vector<long> keys(n);
+	mt19937_64 rng(n);
+	for(long& k : keys)
+		k = rng() % (n * 4);
+	vector<long> sorted(keys);
+	nth_element(sorted.begin(), sorted.begin() + n / 100, sorted.end());
+	long cut = sorted[n / 100];
+	{
+		auto start = bench_clock::now();
+		FibHeap<long> fh;
+		for(long k : keys)
+			fh.push(k);
+		while(!fh.empty())
+			fh.pop();
+		cout << "  FibHeap        n=" << n << ": " << seconds_since(start) << " s" << endl;
+	}
+	for(double eps : { 0.01, 0.1, 0.5 }) {
+		auto start = bench_clock::now();
+		FibSoftHeap<long> sh(eps);
+		for(long k : keys)
+			sh.push(k);
+		long hits = 0;
+		for(long i = 0; !sh.empty(); ++i) {
+			if(i < n / 100)
+				hits += sh.top() < cut;
+			sh.pop();
+		}
+		cout << "  soft eps=" << eps << (eps < 0.1 ? "" : " ") << " n=" << n << ": " << seconds_since(start) << " s, "
+		     << 100.0 * hits / (n / 100) << "% top 1% recall" << endl;
+	}
+}
+
+/*
+ * phases of pops only and of deep decrease_keys (16 per pop) on the array,
+ * the Fibonacci heap and the adaptive heap, which has to find out.
+ */
+double mixed_phases(long n, const vector<int>& phases, int mode) {
+	typedef FibAdaptiveHeap<long> Heap;
+	Heap h(less<long>(), fib_adaptive_costs(), mode == 2);
+	if(mode < 2)
+		h.set_representation(mode == 1, false);
+	mt19937_64 rng(n);
+	vector<Heap::handle> live;
+	unordered_map<Heap::handle, size_t> index;
+	auto push = [&](long k) {
+		Heap::handle x = h.push(k);
+		index[x] = live.size();
+		live.push_back(x);
+	};
+	for(long i = 0; i < n; ++i)
+		push(rng() % (n * 1024));
+	auto start = bench_clock::now();
+	for(int decreases : phases)
+		for(long i = 0; i < n * 2; ++i) {
+			for(int d = 0; d < decreases; ++d) {
+				Heap::handle x = live[rng() % live.size()];
+				h.decrease_key(x, h.top() - 1 - long(rng() % 1024));
+			}
+			Heap::handle t = h.top_handle();
+			long k = h.top();
+			size_t at = index[t];
+			index[live.back()] = at;
+			live[at] = live.back();
+			live.pop_back();
+			index.erase(t);
+			h.pop();
+			push(k + long(rng() % (n * 1024)));
+		}
+	return seconds_since(start);
+}
+
+void bench_adaptive() {
+	cout << "adaptive" << endl;
+	const long n = 100000;
+	const vector<int> workloads[] = { { 0 }, { 16 }, { 0, 16, 0 } };
+	const char* names[] = { "pops only      ", "deep decreases ", "phases         " };
+	for(int w = 0; w < 3; ++w)
+		cout << "  " << names[w] << "n=" << n << ": d-ary " << mixed_phases(n, workloads[w], 0)
+		     << " s, Fibonacci " << mixed_phases(n, workloads[w], 1) << " s, adaptive " << mixed_phases(n, workloads[w], 2) << " s" << endl;
+}
+
+// a Dijkstra-like mix of pushes, two decrease_key per push, pops and removes.
+void record_trace(const string& path, long n) {
+	typedef FibHeap<int64_t>::FibNode Node;
+	FibTraced<FibHeap<int64_t>> h(path);
+	mt19937_64 rng(11);
+	vector<Node*> live; // each node's payload is its index here.
+	auto forget = [&live](Node* x) {
+		size_t i = reinterpret_cast<uintptr_t>(x->payload);
+		live[i] = live.back();
+		live[i]->payload = reinterpret_cast<void*>(i);
+		live.pop_back();
+	};
+	for(long i = 0; i < n; ++i) {
+		live.push_back(h.push(rng() % 1000000000, reinterpret_cast<void*>(live.size())));
+		for(int d = 0; d < 2; ++d) {
+			Node* x = live[rng() % live.size()];
+			h.decrease_key(x, x->key - int64_t(rng() % 1000));
+		}
+		if(i % 16 == 15) {
+			Node* x = live[rng() % live.size()];
+			forget(x);
+			h.remove_fibnode(x);
+		} else if(i % 2) {
+			forget(h.topNode());
+			h.pop();
+		}
+	}
+}
+
+template<class Adapter>
+void replay_trace(const char* name, const vector<fib_trace_op<int64_t>>& ops) {
+	fib_replay_stats s = fib_replay<Adapter>(ops);
+	const char* kinds[] = { "push", "pop", "decrease_key", "remove" };
+	cout << "  " << name << s.ops_per_second / 1e6 << " M ops/s, peak " << s.peak_memory / 1e6 << " MB, p50/p99/p99.9 ns:";
+	for(int k = 0; k < 4; ++k)
+		if(s.latency[k].count)
+			cout << " " << kinds[k] << " " << s.latency[k].p50 << "/" << s.latency[k].p99 << "/" << s.latency[k].p999;
+	if(s.mismatches)
+		cout << ", " << s.mismatches << " pops of another key";
+	cout << endl;
+}
+
+// replays FIBOHEAP_TRACE, a trace of int64_t keys, or else a recorded mix.
+void bench_trace() {
+	cout << "trace" << endl;
+	const char* env = getenv("FIBOHEAP_TRACE");
+	string path = env ? env : "/tmp/fibotrace-bench";
+	if(!env) {
+		bench_clock::time_point start = bench_clock::now();
+		record_trace(path, 1000000);
+		cout << "  recorded " << path << " in " << seconds_since(start) << " s" << endl;
+	}
+	vector<fib_trace_op<int64_t>> ops;
+	if(!fib_trace_read(path, ops))
+		return;
+	cout << "  " << ops.size() << " operations" << endl;
+	replay_trace<fib_replay_adapter<FibHeap<int64_t>>>("FibHeap         ", ops);
+	replay_trace<fib_replay_adapter<FibHeap<int64_t, less<int64_t>, true>>>("stable FibHeap  ", ops);
+	replay_trace<fib_replay_adapter<FibQueue<int64_t>>>("FibQueue        ", ops);
+	replay_trace<fib_replay_adapter<FibHugePageHeap<int64_t>>>("FibHugePageHeap ", ops);
+	if(!env)
+		unlink(path.c_str());
+}
+
+/*
+ * a scheduler on (deadline, tenant, sequence) keys, with deadlines drawn
+ * from few values so that comparisons often reach the later fields: pushes,
+ * a decrease_key per push and pops, on the given heap of keys made by make.
+ */
+template<class Heap, class Make>
+double tuple_schedule(long n, Make make) {
+	mt19937_64 rng(n);
+	Heap h;
+	vector<typename Heap::FibNode*> nodes;
+	nodes.reserve(n);
+	auto start = bench_clock::now();
+	for(long i = 0; i < n; ++i) {
+		nodes.push_back(h.push(make(int(rng() % 1000), uint8_t(rng() % 4), uint32_t(i))));
+		typename Heap::FibNode* x = nodes[rng() % nodes.size()];
+		auto k = make(int(rng() % 1000) - 1000, uint8_t(0), uint32_t(i));
+		if(h.key_comp()(k, x->key))
+			h.decrease_key(x, k);
+	}
+	long check = 0;
+	while(!h.empty()) {
+		h.pop();
+		check++;
+	}
+	double secs = seconds_since(start);
+	return check == n ? secs : -1;
+}
+
+void bench_tuple() {
+	cout << "tuple" << endl;
+	typedef tuple<int64_t, uint8_t, uint32_t> Wide; // 104 bits, packed into 128.
+	typedef tuple<int32_t, uint8_t, uint16_t> Narrow; // 56 bits, packed into 64.
+	auto wide = [](int d, uint8_t t, uint32_t s) { return Wide(d, t, s); };
+	auto narrow = [](int d, uint8_t t, uint32_t s) { return Narrow(d, t, uint16_t(s)); };
+	for(long n : { 100000L, 1000000L }) {
+		cout << "  128-bit n=" << n << ": std::less " << tuple_schedule<FibHeap<Wide>>(n, wide)
+		     << " s, fib_tuple_less " << tuple_schedule<FibHeap<Wide, fib_tuple_less<Wide>>>(n, wide)
+		     << " s, packed " << tuple_schedule<FibTupleHeap<Wide>>(n, wide) << " s" << endl;
+		cout << "   64-bit n=" << n << ": std::less " << tuple_schedule<FibHeap<Narrow>>(n, narrow)
+		     << " s, fib_tuple_less " << tuple_schedule<FibHeap<Narrow, fib_tuple_less<Narrow>>>(n, narrow)
+		     << " s, packed " << tuple_schedule<FibTupleHeap<Narrow>>(n, narrow) << " s" << endl;
+	}
+}
+
+/*
+ * workers taking jobs in batches of k from a heap of n: each round pushes k
+ * new jobs, then takes k with k pop() or one pop_n(k).
+ */
+template<class Heap>
+double dequeue_batches(long n, size_t k, bool batched) {
+	mt19937_64 rng(n);
+	Heap h;
+	for(long i = 0; i < n; ++i)
+		h.push(rng() % (n * 16));
+	h.pop();
+	vector<long> jobs;
+	jobs.reserve(k);
+	long rounds = 4000000 / long(k), check = 0;
+	auto start = bench_clock::now();
+	for(long r = 0; r < rounds; ++r) {
+		for(size_t i = 0; i < k; ++i)
+			h.push(rng() % (n * 16));
+		jobs.clear();
+		if(batched)
+			h.pop_n(k, back_inserter(jobs));
+		else
+			for(size_t i = 0; i < k; ++i) {
+				jobs.push_back(h.top());
+				h.pop();
+			}
+		check += jobs.size();
+	}
+	double secs = seconds_since(start);
+	return check == rounds * long(k) ? secs : -1;
+}
+
+void bench_batch() {
+	cout << "batch" << endl;
+	for(long n : { 10000L, 1000000L })
+		for(size_t k : { size_t(64), size_t(256) }) {
+			cout << "  n=" << n << " k=" << k << ": FibHeap pop " << dequeue_batches<FibHeap<long>>(n, k, false)
+			     << " s, pop_n " << dequeue_batches<FibHeap<long>>(n, k, true)
+			     << " s; FibQueue pop " << dequeue_batches<FibQueue<long>>(n, k, false)
+			     << " s, pop_n " << dequeue_batches<FibQueue<long>>(n, k, true) << " s" << endl;
+		}
+}
+
+int main(int argc, char* argv[]) {
+	struct { const char* name; void (*run)(); } benches[] = {
+		{ "coro", bench_coro },
+		{ "graph", bench_graph },
+		{ "des", bench_des },
+		{ "pop", bench_pop },
+		{ "hugepage", bench_hugepage },
+		{ "bulk", bench_bulk },
+		{ "clone", bench_clone },
+		{ "erase", bench_erase },
+		{ "persistent", bench_persistent },
+		{ "soft", bench_soft },
+		{ "adaptive", bench_adaptive },
+		{ "trace", bench_trace },
+		{ "tuple", bench_tuple },
+		{ "batch", bench_batch },
+	};
+	for(auto& b : benches) {
+		bool selected = argc < 2;
+		for(int i = 1; i < argc; ++i)
+			selected |= strcmp(argv[i], b.name) == 0;
+		if(selected)
+			b.run();
+	}
+}
@@ -0,0 +1,349 @@
+/**
+ * Adaptive heap
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Priority queue with mutable keys that can pick its representation from the
+ * operations it sees. It starts as an implicit D-ary array heap, which wins
+ * when keys rarely change, and, when adaptation is turned on, moves all its
+ * elements to a FibHeap when decrease_key calls become frequent enough to pay
+ * for the move, and back when they stop.
+ *
+ * Handles are small entries of their own, pointed to by the array slots or
+ * by the payload of the Fibonacci nodes, so they stay valid across moves.
+ * Decisions are taken once per window of max(n, 1024) operations, from a
+ * cost model in fib_adaptive_costs; a move costs O(n), so that it is
+ * amortized over the window.
+ *
+ * Adaptation is opt-in. The default costs, measured on 64-bit keys, put the
+ * array ahead on every mix, and so does the bench: with 16 decrease_key calls
+ * to the top per pop the array is still faster, at 10^5 elements as at 2.10^6
+ * where its sifts miss the cache. Counting the window is then pure overhead,
+ * so it is only done when asked for, with costs measured for larger keys or
+ * other hardware, where the array moves are dearer.
+ */
+
+#ifndef FIBOADAPTIVE_H
+#define FIBOADAPTIVE_H
+
+#include "fiboheap.h"
+#include "fibopool.h"
+#include <cstddef>
+#include <functional>
+#include <math.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * estimated nanoseconds per operation, with lg the log2 of the size and
+ * levels the slots a decrease_key moves up the array. The defaults were
+ * measured with bench_fiboheap.cc "adaptive" on 64-bit keys, where a
+ * Fibonacci decrease_key also pays for linking its root at the next pop.
+ */
+struct fib_adaptive_costs
+{
+  double dary_push = 50.0;
+  double dary_pop_lg = 32.0;
+  double dary_decrease = 40.0;
+  double dary_decrease_level = 8.0;
+  double fib_push = 40.0;
+  double fib_pop_lg = 84.0;
+  double fib_decrease = 240.0;
+  double migrate_n = 150.0;
+};
+
+template<class T, class Comp = std::less<T>, unsigned D = 4>
+class FibAdaptiveHeap
+{
+ public:
+  struct entry;
+  typedef FibHeap<T, Comp, false, entry*> Heap;
+  typedef entry* handle;
+
+  struct entry
+  {
+    std::size_t pos; // slot in the array heap.
+    typename Heap::FibNode *node; // node in the Fibonacci heap.
+  };
+
+  FibAdaptiveHeap(Comp comp = Comp(), fib_adaptive_costs costs = fib_adaptive_costs(), bool adapt = false)
+    :fib(comp),comp(comp),costs(costs),use_fib(false),adaptive(adapt),levels_per_decrease(0.0)
+  {
+    reset_counts();
+  }
+
+  ~FibAdaptiveHeap()
+    {
+      clear();
+    }
+
+  FibAdaptiveHeap(const FibAdaptiveHeap&) = delete;
+  FibAdaptiveHeap& operator=(const FibAdaptiveHeap&) = delete;
+
+  void clear()
+  {
+    if (use_fib)
+      {
+	fib.for_each_node([this](typename Heap::FibNode *x) {
+	    entries.deallocate(x->payload);
+	  });
+	fib.clear();
+      }
+    else
+      {
+	for (slot &s : slots)
+	  entries.deallocate(s.e);
+	slots.clear();
+      }
+    reset_counts();
+  }
+
+  handle push(T k)
+  {
+    entry *e = static_cast<entry*>(entries.allocate());
+    if (use_fib)
+      e->node = fib.push(std::move(k), e);
+    else
+      {
+	e->pos = slots.size();
+	slots.push_back(slot { std::move(k), e });
+	sift_up(e->pos);
+      }
+    count(pushes);
+    return e;
+  }
+
+  const T& top() const
+  {
+    return use_fib ? fib.min->key : slots[0].key;
+  }
+
+  handle top_handle() const
+  {
+    return use_fib ? fib.min->payload : slots[0].e;
+  }
+
+  void pop()
+  {
+    if (empty())
+      return;
+    if (use_fib)
+      {
+	typename Heap::FibNode *x = fib.extract_min();
+	entries.deallocate(x->payload);
+	fib.destroy_node(x);
+      }
+    else
+      {
+	entry *e = slots[0].e;
+	if (slots.size() > 1)
+	  {
+	    move_slot(slots.size() - 1, 0);
+	    slots.pop_back();
+	    sift_down(0);
+	  }
+	else
+	  slots.pop_back();
+	entries.deallocate(e);
+      }
+    count(pops);
+  }
+
+  const T& key(handle h) const
+  {
+    return use_fib ? h->node->key : slots[h->pos].key;
+  }
+
+  /*
+   * k must not be greater than the current key of h.
+   */
+  void decrease_key(handle h, T k)
+  {
+    if (use_fib)
+      fib.decrease_key(h->node, std::move(k));
+    else
+      {
+	slots[h->pos].key = std::move(k);
+	levels += sift_up(h->pos);
+      }
+    count(decreases);
+  }
+
+  bool empty() const
+  {
+    return size() == 0;
+  }
+
+  std::size_t size() const
+  {
+    return use_fib ? static_cast<std::size_t>(fib.n) : slots.size();
+  }
+
+  /*
+   * whether the elements are in the Fibonacci heap rather than the array.
+   */
+  bool fibonacci() const
+  {
+    return use_fib;
+  }
+
+  /*
+   * moves to the given representation now, and keeps it from then on when
+   * adapt is false.
+   */
+  void set_representation(bool fibonacci, bool adapt = true)
+  {
+    adaptive = adapt;
+    if (fibonacci != use_fib)
+      migrate();
+  }
+
+ private:
+  struct slot
+  {
+    T key;
+    entry *e;
+  };
+
+  enum { pushes, pops, decreases };
+
+  void reset_counts()
+  {
+    ops[pushes] = ops[pops] = ops[decreases] = 0;
+    levels = 0;
+  }
+
+  void count(int op)
+  {
+    ops[op]++;
+    if (!adaptive)
+      return;
+    std::size_t window = size() > 1024 ? size() : 1024;
+    if (ops[pushes] + ops[pops] + ops[decreases] >= window)
+      decide();
+  }
+
+  /*
+   * prices the last window on both representations, and moves when the
+   * other one would have saved more than the move costs. The levels of a
+   * decrease_key are only seen on the array, the Fibonacci side reuses the
+   * last measure.
+   */
+  void decide()
+  {
+    double lg = log2(static_cast<double>(size() + 2));
+    if (!use_fib && ops[decreases])
+      levels_per_decrease = static_cast<double>(levels) / ops[decreases];
+    double dary = ops[pushes] * costs.dary_push + ops[pops] * costs.dary_pop_lg * lg
+      + ops[decreases] * (costs.dary_decrease + costs.dary_decrease_level * levels_per_decrease);
+    double fibo = ops[pushes] * costs.fib_push + ops[pops] * costs.fib_pop_lg * lg + ops[decreases] * costs.fib_decrease;
+    double saved = use_fib ? fibo - dary : dary - fibo;
+    if (saved > costs.migrate_n * size())
+      migrate();
+    reset_counts();
+  }
+
+  void migrate()
+  {
+    if (use_fib)
+      {
+	// the nodes are read in any order, then heapified in O(n).
+	slots.reserve(fib.n);
+	fib.for_each_node([this](typename Heap::FibNode *x) {
+	    x->payload->pos = slots.size();
+	    slots.push_back(slot { std::move(x->key), x->payload });
+	  });
+	fib.clear();
+	for (std::size_t i = slots.size() / D + 1; i-- > 0;)
+	  if (i < slots.size())
+	    sift_down(i);
+      }
+    else
+      {
+	for (slot &s : slots)
+	  s.e->node = fib.push(std::move(s.key), s.e);
+	slots.clear();
+	slots.shrink_to_fit();
+      }
+    use_fib = !use_fib;
+  }
+
+  void move_slot(std::size_t from, std::size_t to)
+  {
+    if (from != to)
+      slots[to] = std::move(slots[from]);
+    slots[to].e->pos = to;
+  }
+
+  /*
+   * hole-based sifts: the moving slot is held aside and written once.
+   */
+  std::size_t sift_up(std::size_t i)
+  {
+    std::size_t moved = 0;
+    slot s = std::move(slots[i]);
+    while (i > 0)
+      {
+	std::size_t p = (i - 1) / D;
+	if (!comp(s.key, slots[p].key))
+	  break;
+	move_slot(p, i);
+	i = p;
+	moved++;
+      }
+    slots[i] = std::move(s);
+    slots[i].e->pos = i;
+    return moved;
+  }
+
+  void sift_down(std::size_t i)
+  {
+    std::size_t n = slots.size();
+    slot s = std::move(slots[i]);
+    for (;;)
+      {
+	std::size_t c = i * D + 1;
+	if (c >= n)
+	  break;
+	std::size_t last = c + D < n ? c + D : n;
+	std::size_t m = c;
+	for (std::size_t j = c + 1; j < last; j++)
+	  if (comp(slots[j].key, slots[m].key))
+	    m = j;
+	if (!comp(slots[m].key, s.key))
+	  break;
+	move_slot(m, i);
+	i = m;
+      }
+    slots[i] = std::move(s);
+    slots[i].e->pos = i;
+  }
+
+  Heap fib;
+  Comp comp;
+  fib_adaptive_costs costs;
+  std::vector<slot> slots;
+  fib_node_pool<entry> entries;
+  bool use_fib;
+  bool adaptive;
+  std::size_t ops[3];
+  std::size_t levels; // moved by decrease_key on the array in this window.
+  double levels_per_decrease;
+};
+
+#endif
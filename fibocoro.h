@@ -0,0 +1,288 @@
+/**
+ * Fibonacci Heap coroutine scheduler
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Single-threaded priority executor for C++20 coroutines, with a Fibonacci
+ * heap as the ready queue and another one for sleepers. Each coroutine frame
+ * embeds its own heap nodes, so suspending and resuming allocates nothing, and
+ * the priority of a waiting coroutine can be changed in place with
+ * reprioritize(). Smaller priorities run first.
+ *
+ *   FibScheduler<>::task worker(FibScheduler<> &s) {
+ *     co_await s.yield(3);
+ *     co_await s.sleep_until(std::chrono::steady_clock::now() + 1ms);
+ *   }
+ *   FibScheduler<> s; s.spawn(worker(s), 0); s.run();
+ */
+
+#ifndef FIBOCORO_H
+#define FIBOCORO_H
+
+#include "fiboheap.h"
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <utility>
+
+template<class Priority = int, class Comp = std::less<Priority>, class Clock = std::chrono::steady_clock>
+class FibScheduler
+{
+ public:
+  using time_point = typename Clock::time_point;
+  using ReadyHeap = FibHeap<Priority, Comp>;
+  using SleepHeap = FibHeap<time_point>;
+
+  enum class state { created, ready, sleeping, running };
+
+  struct promise_type;
+  using handle = std::coroutine_handle<promise_type>;
+
+  class task
+  {
+  public:
+    using promise_type = FibScheduler::promise_type;
+
+    explicit task(handle h)
+      :h(h)
+    {
+    }
+
+    task(task &&o) noexcept
+      :h(std::exchange(o.h, nullptr))
+    {
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    ~task()
+      {
+	if (h)
+	  h.destroy();
+      }
+
+    handle release()
+    {
+      return std::exchange(h, nullptr);
+    }
+
+  private:
+    handle h;
+  };
+
+  struct promise_type
+  {
+    task get_return_object()
+    {
+      return task(handle::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_always final_suspend() noexcept
+    {
+      return {};
+    }
+
+    void return_void()
+    {
+    }
+
+    void unhandled_exception()
+    {
+      error = std::current_exception();
+    }
+
+    // embedded in the coroutine frame and reused for every suspension.
+    typename ReadyHeap::FibNode ready_node { Priority(), nullptr };
+    typename SleepHeap::FibNode sleep_node { time_point(), nullptr };
+    state st = state::created;
+    std::exception_ptr error;
+  };
+
+  struct yield_awaiter
+  {
+    bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(handle h)
+    {
+      h.promise().ready_node.key = priority;
+      sched->make_ready(h);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+    FibScheduler *sched;
+    Priority priority;
+  };
+
+  struct sleep_awaiter
+  {
+    bool await_ready() const noexcept
+    {
+      return false;
+    }
+
+    void await_suspend(handle h)
+    {
+      promise_type &p = h.promise();
+      p.sleep_node.key = deadline;
+      p.sleep_node.payload = h.address();
+      p.st = state::sleeping;
+      sched->sleepers.insert(&p.sleep_node);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+    FibScheduler *sched;
+    time_point deadline;
+  };
+
+  FibScheduler()
+    {
+    }
+
+  FibScheduler(Comp comp)
+    :ready(comp)
+  {
+  }
+
+  ~FibScheduler()
+    {
+      // the heaps must not free the embedded nodes, drain them first.
+      while (!ready.empty())
+	handle::from_address(ready.extract_min()->payload).destroy();
+      while (!sleepers.empty())
+	handle::from_address(sleepers.extract_min()->payload).destroy();
+    }
+
+  FibScheduler(const FibScheduler&) = delete;
+  FibScheduler& operator=(const FibScheduler&) = delete;
+
+  /*
+   * hands the coroutine over to the scheduler, ready at priority p.
+   */
+  handle spawn(task t, Priority p)
+  {
+    handle h = t.release();
+    h.promise().ready_node.key = p;
+    make_ready(h);
+    ++live;
+    return h;
+  }
+
+  /*
+   * re-queues the current coroutine at priority p.
+   */
+  yield_awaiter yield(Priority p)
+  {
+    return yield_awaiter { this, p };
+  }
+
+  /*
+   * suspends the current coroutine until deadline, it then resumes at its last priority.
+   */
+  sleep_awaiter sleep_until(time_point deadline)
+  {
+    return sleep_awaiter { this, deadline };
+  }
+
+  /*
+   * changes the priority of a spawned coroutine, in place if it is ready.
+   */
+  void reprioritize(handle h, Priority p)
+  {
+    promise_type &pr = h.promise();
+    if (pr.st == state::ready)
+      ready.update_key(&pr.ready_node, p);
+    else
+      pr.ready_node.key = p;
+  }
+
+  /*
+   * runs until every spawned coroutine has completed.
+   * An exception escaping a coroutine is rethrown from here.
+   */
+  void run()
+  {
+    while (live > 0)
+      {
+	wake_sleepers();
+	if (ready.empty())
+	  {
+	    if (sleepers.empty())
+	      break;
+	    std::this_thread::sleep_until(sleepers.top());
+	    continue;
+	  }
+	handle h = handle::from_address(ready.extract_min()->payload);
+	h.promise().st = state::running;
+	h.resume();
+	if (h.done())
+	  {
+	    std::exception_ptr error = h.promise().error;
+	    h.destroy();
+	    --live;
+	    if (error)
+	      std::rethrow_exception(error);
+	  }
+      }
+  }
+
+  std::size_t size() const
+  {
+    return live;
+  }
+
+ private:
+  void make_ready(handle h)
+  {
+    promise_type &p = h.promise();
+    p.ready_node.payload = h.address();
+    p.st = state::ready;
+    ready.insert(&p.ready_node);
+  }
+
+  void wake_sleepers()
+  {
+    if (sleepers.empty())
+      return;
+    time_point now = Clock::now();
+    while (!sleepers.empty() && !(now < sleepers.top()))
+      make_ready(handle::from_address(sleepers.extract_min()->payload));
+  }
+
+  ReadyHeap ready;
+  SleepHeap sleepers;
+  std::size_t live = 0;
+};
+
+#endif
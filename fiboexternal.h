@@ -0,0 +1,366 @@
+/**
+ * External-memory Fibonacci Heap
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Priority queue for more items than fit in RAM. New items go to an in-memory
+ * FibHeap; when it exceeds its memory cap, its larger half is drained in order
+ * into a sorted run on disk with large sequential writes, and the smaller half,
+ * which is popped next, stays in memory. The top is the smallest of the
+ * in-memory heap and of the run heads, which are read back one block at a time.
+ * Runs are merged by levels, as many at a time as the run buffers of the memory
+ * cap allow: the spilled runs are level 0, and once a level holds that many
+ * runs they are merged into one run of the next level. Each item is thus
+ * rewritten once per level, a logarithmic number of times, and at most
+ * fan-in - 1 runs per level are open at once.
+ *
+ * Keys must be trivially copyable. Run files are created in the given
+ * directory and unlinked right away, so they vanish with the heap.
+ */
+
+#ifndef FIBOEXTERNAL_H
+#define FIBOEXTERNAL_H
+
+#include "fiboheap.h"
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+template<class T, class Comp = std::less<T>>
+class FibExternalHeap
+{
+ public:
+  using Heap = FibHeap<T, Comp>;
+
+  /*
+   * memory_cap: bytes for the in-memory heap and the run buffers.
+   * block_size: bytes per disk read or write.
+   */
+  FibExternalHeap(std::size_t memory_cap = std::size_t(256) << 20,
+		  std::size_t block_size = std::size_t(1) << 20,
+		  const std::string &dir = "/tmp",
+		  Comp comp = Comp())
+    :mem(comp),runs(run_less { comp }),dir(dir),n(0),items_written(0)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "external heap keys must be trivially copyable");
+    block_items = block_size / sizeof(T) ? block_size / sizeof(T) : 1;
+    mem_cap = memory_cap / 2 / sizeof(typename Heap::FibNode);
+    if (mem_cap == 0)
+      mem_cap = 1;
+    fan_in = memory_cap / 2 / (block_items * sizeof(T));
+    if (fan_in < 2)
+      fan_in = 2;
+  }
+
+  ~FibExternalHeap()
+    {
+      clear();
+    }
+
+  FibExternalHeap(const FibExternalHeap&) = delete;
+  FibExternalHeap& operator=(const FibExternalHeap&) = delete;
+
+  void clear()
+  {
+    mem.clear();
+    while (!runs.empty())
+      {
+	typename RunHeap::FibNode *x = runs.extract_min();
+	delete x->key;
+	runs.destroy_node(x);
+      }
+    level_runs.clear();
+    n = 0;
+  }
+
+  void push(T k)
+  {
+    mem.push(std::move(k));
+    ++n;
+    if (static_cast<std::size_t>(mem.n) > mem_cap)
+      spill();
+  }
+
+  const T& top()
+  {
+    if (runs.empty() || (!mem.empty() && !mem.comp(runs.top()->head(), mem.top())))
+      return mem.top();
+    return runs.top()->head();
+  }
+
+  void pop()
+  {
+    if (empty())
+      return;
+    if (runs.empty() || (!mem.empty() && !mem.comp(runs.top()->head(), mem.top())))
+      mem.pop();
+    else
+      advance_top_run();
+    --n;
+  }
+
+  bool empty() const
+  {
+    return n == 0;
+  }
+
+  std::size_t size() const
+  {
+    return n;
+  }
+
+  std::size_t memory_size() const
+  {
+    return static_cast<std::size_t>(mem.n);
+  }
+
+  std::size_t run_count() const
+  {
+    return static_cast<std::size_t>(runs.n);
+  }
+
+  /*
+   * items written to disk so far, by spills and merges.
+   */
+  std::size_t written() const
+  {
+    return items_written;
+  }
+
+ private:
+  /*
+   * sorted run on disk, read back one block at a time.
+   */
+  struct run
+  {
+    run(std::FILE *f, std::size_t items, std::size_t block_items, std::size_t level)
+      :f(f),remaining(items),buf(block_items),pos(0),count(0),level(level)
+    {
+      refill();
+    }
+
+    ~run()
+      {
+	std::fclose(f);
+      }
+
+    const T& head() const
+    {
+      return buf[pos];
+    }
+
+    // items not read yet.
+    std::size_t size() const
+    {
+      return remaining + (count - pos);
+    }
+
+    // false once exhausted.
+    bool next()
+    {
+      if (++pos < count)
+	return true;
+      return refill();
+    }
+
+    bool refill()
+    {
+      std::size_t want = remaining < buf.size() ? remaining : buf.size();
+      if (want == 0)
+	return false;
+      if (std::fread(buf.data(), sizeof(T), want, f) != want)
+	throw std::runtime_error("failed reading external heap run");
+      remaining -= want;
+      pos = 0;
+      count = want;
+      return true;
+    }
+
+    std::FILE *f;
+    std::size_t remaining;
+    std::vector<T> buf;
+    std::size_t pos;
+    std::size_t count;
+    std::size_t level;
+  };
+
+  struct run_less
+  {
+    bool operator()(const run *x, const run *y) const
+    {
+      return comp(x->head(), y->head());
+    }
+
+    Comp comp;
+  };
+
+  using RunHeap = FibHeap<run*, run_less>;
+
+  std::FILE* create_run_file()
+  {
+    std::string tmpl = dir + "/fiboheap-run-XXXXXX";
+    std::vector<char> path(tmpl.begin(), tmpl.end());
+    path.push_back('\0');
+    int fd = ::mkstemp(path.data());
+    if (fd < 0)
+      throw std::runtime_error("cannot create external heap run in " + dir);
+    ::unlink(path.data());
+    std::FILE *f = ::fdopen(fd, "w+b");
+    if (!f)
+      {
+	::close(fd);
+	throw std::runtime_error("cannot open external heap run");
+      }
+    return f;
+  }
+
+  /*
+   * writes a sorted run of the given level with block-sized sequential
+   * writes, then reopens it for reading.
+   */
+  template<class Source>
+  void write_run(Source next_item, std::size_t items, std::size_t level)
+  {
+    std::FILE *f = create_run_file();
+    std::vector<T> block;
+    block.reserve(block_items);
+    for (std::size_t i = 0; i < items; i++)
+      {
+	block.push_back(next_item());
+	if (block.size() == block_items || i + 1 == items)
+	  {
+	    if (std::fwrite(block.data(), sizeof(T), block.size(), f) != block.size())
+	      {
+		std::fclose(f);
+		throw std::runtime_error("failed writing external heap run");
+	      }
+	    block.clear();
+	  }
+      }
+    if (std::fflush(f) != 0 || std::fseek(f, 0, SEEK_SET) != 0)
+      {
+	std::fclose(f);
+	throw std::runtime_error("failed writing external heap run");
+      }
+    runs.push(new run(f, items, block_items, level));
+    if (level_runs.size() <= level)
+      level_runs.resize(level + 1, 0);
+    level_runs[level]++;
+    items_written += items;
+  }
+
+  void spill()
+  {
+    // the hot half is taken out, the rest written, and the hot nodes go back
+    // in as they are, so that the next pops do not read them from disk.
+    std::vector<typename Heap::FibNode*> hot = mem.extract_n(mem.n / 2);
+    std::size_t items = mem.n;
+    try
+      {
+	write_run([this]() {
+	    T k = mem.top();
+	    mem.pop();
+	    return k;
+	  }, items, 0);
+      }
+    catch (...)
+      {
+	for (typename Heap::FibNode *x : hot)
+	  mem.insert(x);
+	throw;
+      }
+    for (typename Heap::FibNode *x : hot)
+      mem.insert(x);
+    // a merge may fill the next level up.
+    for (std::size_t level = 0; level < level_runs.size(); level++)
+      if (level_runs[level] >= fan_in)
+	merge_level(level);
+  }
+
+  /*
+   * merges the runs of a level into one run of the next level.
+   */
+  void merge_level(std::size_t level)
+  {
+    std::size_t items = 0;
+    RunHeap merging(runs.key_comp());
+    runs.erase_if([&](typename RunHeap::FibNode *x) {
+	if (x->key->level != level)
+	  return false;
+	items += x->key->size();
+	merging.push(x->key);
+	return true;
+      });
+    level_runs[level] = 0;
+    try
+      {
+	write_run([&merging]() {
+	    run *r = merging.top();
+	    T k = r->head();
+	    if (r->next())
+	      merging.increase_key(merging.topNode(), r);
+	    else
+	      {
+		merging.pop();
+		delete r;
+	      }
+	    return k;
+	  }, items, level + 1);
+      }
+    catch (...)
+      {
+	while (!merging.empty())
+	  {
+	    delete merging.top();
+	    merging.pop();
+	  }
+	throw;
+      }
+  }
+
+  void advance_top_run()
+  {
+    run *r = runs.top();
+    // the head moved forward in place, so the key grew behind the heap's back.
+    if (r->next())
+      runs.increase_key(runs.topNode(), r);
+    else
+      {
+	runs.pop();
+	level_runs[r->level]--;
+	delete r;
+      }
+  }
+
+  Heap mem;
+  RunHeap runs;
+  std::string dir;
+  std::size_t n;
+  std::size_t mem_cap;
+  std::size_t block_items;
+  std::size_t fan_in;
+  std::vector<std::size_t> level_runs; // open runs by level.
+  std::size_t items_written;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * Fibonacci Heap graph algorithms
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Prim/Jarnik minimum spanning forest and bidirectional Dijkstra over graphs
+ * in compressed sparse row form. Each vertex owns one preallocated heap node
+ * slot, used as its handle for decrease_key, so the searches do not allocate per
+ * relaxation and need no key-indexed store.
+ */
+
+#ifndef FIBOGRAPH_H
+#define FIBOGRAPH_H
+
+#include "fiboheap.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+template<class W>
+struct FibCsrGraph
+{
+  typedef std::tuple<uint32_t, uint32_t, W> Edge;
+
+  /*
+   * builds the graph from an edge list, undirected edges are stored both ways.
+   */
+  static FibCsrGraph from_edges(std::size_t vertices, const std::vector<Edge> &edges, bool undirected = false)
+  {
+    FibCsrGraph g;
+    g.offsets.assign(vertices + 1, 0);
+    for (const Edge &e : edges)
+      {
+	g.offsets[std::get<0>(e) + 1]++;
+	if (undirected)
+	  g.offsets[std::get<1>(e) + 1]++;
+      }
+    for (std::size_t v = 0; v < vertices; v++)
+      g.offsets[v + 1] += g.offsets[v];
+    g.targets.resize(g.offsets[vertices]);
+    g.weights.resize(g.offsets[vertices]);
+    std::vector<std::size_t> pos(g.offsets.begin(), g.offsets.end() - 1);
+    for (const Edge &e : edges)
+      {
+	std::size_t i = pos[std::get<0>(e)]++;
+	g.targets[i] = std::get<1>(e);
+	g.weights[i] = std::get<2>(e);
+	if (undirected)
+	  {
+	    i = pos[std::get<1>(e)]++;
+	    g.targets[i] = std::get<0>(e);
+	    g.weights[i] = std::get<2>(e);
+	  }
+      }
+    return g;
+  }
+
+  /*
+   * the same graph with every edge reversed.
+   */
+  FibCsrGraph reversed() const
+  {
+    std::vector<Edge> edges;
+    edges.reserve(targets.size());
+    for (std::size_t u = 0; u < vertices(); u++)
+      for (std::size_t i = offsets[u]; i < offsets[u + 1]; i++)
+	edges.push_back(Edge(targets[i], static_cast<uint32_t>(u), weights[i]));
+    return from_edges(vertices(), edges);
+  }
+
+  std::size_t vertices() const
+  {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+
+  std::vector<std::size_t> offsets;
+  std::vector<uint32_t> targets;
+  std::vector<W> weights;
+};
+
+static const uint32_t fib_no_vertex = std::numeric_limits<uint32_t>::max();
+
+/*
+ * heap with one node slot per vertex. Slots are left uninitialized until the
+ * vertex is first pushed, so that a search only pays for the vertices it reaches.
+ */
+template<class W>
+struct FibVertexHeap
+{
+  typedef FibHeap<W> Heap;
+  typedef typename Heap::FibNode Node;
+  typedef typename std::aligned_storage<sizeof(Node), alignof(Node)>::type Slot;
+
+  FibVertexHeap(std::size_t vertices)
+    :slots(new Slot[vertices])
+  {
+    static_assert(std::is_trivially_destructible<W>::value, "vertex keys must be trivially destructible");
+  }
+
+  ~FibVertexHeap()
+    {
+      heap.min = nullptr;
+      heap.n = 0;
+    }
+
+  Node* node(uint32_t v)
+  {
+    return reinterpret_cast<Node*>(&slots[v]);
+  }
+
+  void push(uint32_t v, W k)
+  {
+    heap.insert(new (&slots[v]) Node(k, reinterpret_cast<void*>(static_cast<uintptr_t>(v))));
+  }
+
+  uint32_t pop()
+  {
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(heap.extract_min()->payload));
+  }
+
+  Heap heap;
+  std::unique_ptr<Slot[]> slots;
+};
+
+/*
+ * Prim/Jarnik minimum spanning forest of an undirected graph (each edge stored
+ * both ways). Fills parent, with fib_no_vertex for the roots, and returns the
+ * total weight.
+ */
+template<class W>
+W fib_prim_mst(const FibCsrGraph<W> &g, std::vector<uint32_t> &parent)
+{
+  enum { unseen, queued, done };
+  std::size_t nv = g.vertices();
+  FibVertexHeap<W> q(nv);
+  std::vector<char> state(nv, unseen);
+  parent.assign(nv, fib_no_vertex);
+  W total = W();
+
+  for (std::size_t root = 0; root < nv; root++)
+    {
+      if (state[root] != unseen)
+	continue;
+      q.push(static_cast<uint32_t>(root), W());
+      state[root] = queued;
+      while (!q.heap.empty())
+	{
+	  W d = q.heap.top();
+	  uint32_t u = q.pop();
+	  state[u] = done;
+	  if (parent[u] != fib_no_vertex)
+	    total += d;
+	  for (std::size_t i = g.offsets[u]; i < g.offsets[u + 1]; i++)
+	    {
+	      uint32_t v = g.targets[i];
+	      W w = g.weights[i];
+	      if (state[v] == unseen)
+		{
+		  q.push(v, w);
+		  state[v] = queued;
+		  parent[v] = u;
+		}
+	      else if (state[v] == queued && w < q.node(v)->key)
+		{
+		  q.heap.decrease_key(q.node(v), w);
+		  parent[v] = u;
+		}
+	    }
+	}
+    }
+  return total;
+}
+
+/*
+ * shortest distance from s to t with non-negative weights, searching forward on
+ * g and backward on rg = g.reversed(), and stopping as soon as the two frontiers
+ * cannot improve the best meeting point. Returns numeric_limits<W>::max() when
+ * t is unreachable; when path is given, it is filled with the vertices from s to t.
+ */
+template<class W>
+W fib_bidirectional_dijkstra(const FibCsrGraph<W> &g, const FibCsrGraph<W> &rg,
+			     uint32_t s, uint32_t t, std::vector<uint32_t> *path = nullptr)
+{
+  const W inf = std::numeric_limits<W>::max();
+  std::size_t nv = g.vertices();
+  if (path)
+    path->clear();
+  if (s == t)
+    {
+      if (path)
+	path->push_back(s);
+      return W();
+    }
+
+  struct side
+  {
+    side(const FibCsrGraph<W> &g, std::size_t nv, W inf)
+      :g(g),q(nv),dist(nv, inf),parent(nv, fib_no_vertex),settled(nv, 0)
+    {
+    }
+
+    const FibCsrGraph<W> &g;
+    FibVertexHeap<W> q;
+    std::vector<W> dist;
+    std::vector<uint32_t> parent;
+    std::vector<char> settled;
+  };
+  side fw(g, nv, inf), bw(rg, nv, inf);
+  fw.dist[s] = W();
+  fw.q.push(s, W());
+  bw.dist[t] = W();
+  bw.q.push(t, W());
+  W best = inf;
+  uint32_t meet = fib_no_vertex;
+
+  while (!fw.q.heap.empty() && !bw.q.heap.empty())
+    {
+      if (best != inf && !(fw.q.heap.top() + bw.q.heap.top() < best))
+	break;
+      // expand the smaller frontier.
+      bool forward = fw.q.heap.n <= bw.q.heap.n;
+      side &a = forward ? fw : bw;
+      side &b = forward ? bw : fw;
+      uint32_t u = a.q.pop();
+      a.settled[u] = 1;
+      for (std::size_t i = a.g.offsets[u]; i < a.g.offsets[u + 1]; i++)
+	{
+	  uint32_t v = a.g.targets[i];
+	  if (a.settled[v])
+	    continue;
+	  W d = a.dist[u] + a.g.weights[i];
+	  if (a.dist[v] == inf)
+	    {
+	      a.dist[v] = d;
+	      a.parent[v] = u;
+	      a.q.push(v, d);
+	    }
+	  else if (d < a.dist[v])
+	    {
+	      a.dist[v] = d;
+	      a.parent[v] = u;
+	      a.q.heap.decrease_key(a.q.node(v), d);
+	    }
+	  if (b.dist[v] != inf && a.dist[v] + b.dist[v] < best)
+	    {
+	      best = a.dist[v] + b.dist[v];
+	      meet = v;
+	    }
+	}
+    }
+
+  if (path && meet != fib_no_vertex)
+    {
+      for (uint32_t v = meet; v != fib_no_vertex; v = fw.parent[v])
+	path->push_back(v);
+      std::reverse(path->begin(), path->end());
+      for (uint32_t v = bw.parent[meet]; v != fib_no_vertex; v = bw.parent[v])
+	path->push_back(v);
+    }
+  return best;
+}
+
+#endif
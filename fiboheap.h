@@ -19,46 +19,505 @@
 #ifndef FIBOHEAP_H
 #define FIBOHEAP_H
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <math.h>
 #include <limits>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-template<class T, class Comp = std::less<T>>
-class FibHeap
+/*
+ * Define FIBOHEAP_PREFETCH before including this file to prefetch nodes
+ * FIBOHEAP_PREFETCH_DISTANCE steps ahead in the ring walks of consolidate and
+ * extract_min, and the next sibling in delete_fibnodes. It pays off once the
+ * heap no longer fits in the last level cache.
+ */
+#if defined(FIBOHEAP_PREFETCH) && defined(__GNUC__)
+#ifndef FIBOHEAP_PREFETCH_DISTANCE
+#define FIBOHEAP_PREFETCH_DISTANCE 4
+#endif
+#define FIB_PREFETCH(p) __builtin_prefetch((p), 0, 3)
+#define FIB_PREFETCH_W(p) __builtin_prefetch((p), 1, 3)
+#else
+// no walk ahead without prefetches to issue.
+#undef FIBOHEAP_PREFETCH_DISTANCE
+#define FIBOHEAP_PREFETCH_DISTANCE 0
+#define FIB_PREFETCH(p) ((void)0)
+#define FIB_PREFETCH_W(p) ((void)0)
+#endif
+
+/*
+ * node allocators whose nodes live in a few large blocks specialize this to
+ * copy the blocks wholesale when a heap of trivially copyable nodes is copied:
+ *   static const bool enabled = true;
+ *   static Rebase clone(const NodeAlloc &from, NodeAlloc &to);
+ * where to is set to an allocator owning copies of the blocks, rebase(p)
+ * maps a node pointer in from to its copy, and rebase.for_each_copy(f, walk)
+ * calls f on every copied node, by itself or through walk(g), which calls g
+ * on every original node. See fibohugepage.h.
+ */
+template<class NodeAlloc>
+struct fib_block_clone
+{
+  static const bool enabled = false;
+};
+
+/*
+ * node payload storage: a Payload member, or nothing at all for Payload = void.
+ */
+struct fib_no_payload
+{
+};
+
+template<class Payload>
+struct fib_payload
+{
+  fib_payload()
+    :payload()
+  {
+  }
+
+  // never a copy: nodes are copied with their implicit copy constructor.
+  template<class A, class... Args,
+	   class = typename std::enable_if<!std::is_base_of<fib_payload, typename std::decay<A>::type>::value>::type>
+  fib_payload(A &&a, Args&&... args)
+    :payload(std::forward<A>(a), std::forward<Args>(args)...)
+  {
+  }
+
+  Payload payload;
+};
+
+template<>
+struct fib_payload<void>
+{
+  fib_payload()
+  {
+  }
+
+  fib_payload(fib_no_payload)
+  {
+  }
+};
+
+/*
+ * node of FibHeap<T, Comp, Stable, Payload, ...>, also its FibNode.
+ */
+template<class T, class Payload>
+class fib_node : public fib_payload<Payload>
+{
+ public:
+  // the extra arguments construct the payload.
+  template<class... Args>
+  fib_node(T k, Args&&... args)
+    :fib_payload<Payload>(std::forward<Args>(args)...),key(std::move(k)),mark(false),degree(-1),seq(0),p(nullptr),left(nullptr),right(nullptr),child(nullptr)
+  {
+  }
+
+  T key;
+  // one word: degree stays below log_phi(n) + 2, seq is the insertion stamp.
+  uint64_t mark : 1;
+  int64_t degree : 8;
+  uint64_t seq : 55;
+  fib_node *p;
+  fib_node *left;
+  fib_node *right;
+  fib_node *child;
+};
+
+/*
+ * whether a policy object can be an empty base, and so take no space.
+ */
+template<class P>
+struct fib_empty_base
+#if __cplusplus >= 201402L
+  : std::integral_constant<bool, std::is_empty<P>::value && !std::is_final<P>::value>
+#else
+  : std::integral_constant<bool, std::is_empty<P>::value>
+#endif
+{
+};
+
+/*
+ * comparator policy: comp(a,b) calls Comp, stored as a base when it is empty.
+ */
+template<class Comp, bool Empty = fib_empty_base<Comp>::value>
+class fib_compare : private Comp
 {
  public:
+  fib_compare(const Comp &c)
+    :Comp(c)
+  {
+  }
 
-  // node
-  class FibNode
+  template<class A, class B>
+  bool comp(const A &a, const B &b) const
   {
-  public:
-    FibNode(T k, void *pl)
-      :key(std::move(k)),mark(false),p(nullptr),left(nullptr),right(nullptr),child(nullptr),degree(-1),payload(pl)
+    return static_cast<const Comp&>(*this)(a, b);
+  }
+
+  const Comp& key_comp() const
+  {
+    return *this;
+  }
+
+  Comp& key_comp()
+  {
+    return *this;
+  }
+};
+
+template<class Comp>
+class fib_compare<Comp, false>
+{
+ public:
+  fib_compare(const Comp &c)
+    :cmp(c)
+  {
+  }
+
+  template<class A, class B>
+  bool comp(const A &a, const B &b) const
+  {
+    return cmp(a, b);
+  }
+
+  const Comp& key_comp() const
+  {
+    return cmp;
+  }
+
+  Comp& key_comp()
+  {
+    return cmp;
+  }
+
+ private:
+  Comp cmp;
+};
+
+/*
+ * node storage policy: the node allocator, stored as a base when it is empty.
+ */
+template<class NodeAlloc, bool Empty = fib_empty_base<NodeAlloc>::value>
+class fib_node_storage : private NodeAlloc
+{
+ public:
+  fib_node_storage(const NodeAlloc &a)
+    :NodeAlloc(a)
+  {
+  }
+
+  const NodeAlloc& node_alloc() const
+  {
+    return *this;
+  }
+
+  NodeAlloc& node_alloc()
+  {
+    return *this;
+  }
+};
+
+template<class NodeAlloc>
+class fib_node_storage<NodeAlloc, false>
+{
+ public:
+  fib_node_storage(const NodeAlloc &a)
+    :alloc(a)
+  {
+  }
+
+  const NodeAlloc& node_alloc() const
+  {
+    return alloc;
+  }
+
+  NodeAlloc& node_alloc()
+  {
+    return alloc;
+  }
+
+ private:
+  NodeAlloc alloc;
+};
+
+/*
+ * stable ties policy: the insertion counter, only kept by stable heaps.
+ */
+template<bool Stable>
+class fib_sequence
+{
+ public:
+  fib_sequence()
+    :next_seq(0)
+  {
+  }
+
+  uint64_t stamp()
+  {
+    return next_seq++;
+  }
+
+  uint64_t next_sequence() const
+  {
+    return next_seq;
+  }
+
+  // stamps from now on are at least next.
+  void advance_sequence(uint64_t next)
+  {
+    if (next > next_seq)
+      next_seq = next;
+  }
+
+ private:
+  uint64_t next_seq;
+};
+
+template<>
+class fib_sequence<false>
+{
+ public:
+  uint64_t stamp()
+  {
+    return 0;
+  }
+
+  uint64_t next_sequence() const
+  {
+    return 0;
+  }
+
+  void advance_sequence(uint64_t)
+  {
+  }
+};
+
+/*
+ * stats policy: FibHeap calls these hooks on its structural work, which
+ * fib_no_stats compiles away and fib_counting_stats counts, e.g. to check
+ * the amortized cost of a workload. links is the number of roots made
+ * children by consolidate, cuts counts the cascading ones too.
+ */
+struct fib_no_stats
+{
+  void on_insert()
+  {
+  }
+
+  void on_extract()
+  {
+  }
+
+  void on_consolidate(std::size_t, std::size_t)
+  {
+  }
+
+  void on_cut()
+  {
+  }
+};
+
+struct fib_counting_stats
+{
+  fib_counting_stats()
+    :inserts(0),extracts(0),consolidations(0),roots(0),links(0),cuts(0)
+  {
+  }
+
+  void on_insert()
+  {
+    inserts++;
+  }
+
+  void on_extract()
+  {
+    extracts++;
+  }
+
+  void on_consolidate(std::size_t r, std::size_t l)
+  {
+    consolidations++;
+    roots += r;
+    links += l;
+  }
+
+  void on_cut()
+  {
+    cuts++;
+  }
+
+  uint64_t inserts;
+  uint64_t extracts;
+  uint64_t consolidations;
+  uint64_t roots; // walked by consolidate.
+  uint64_t links;
+  uint64_t cuts;
+};
+
+/*
+ * parallel policy: consolidate() first offers the roots to link_roots(),
+ * which links them into the degree table and returns true, or returns false
+ * to leave them to the sequential loop. fib_no_parallel always declines;
+ * fib_parallel_consolidate in fiboparallel.h links them on several threads.
+ */
+struct fib_no_parallel
+{
+  template<class Heap, class Node>
+  bool link_roots(Heap&, Node*, Node**, int, std::size_t&)
+  {
+    return false;
+  }
+};
+
+/*
+ * handle policy: an index to the nodes, by key or by id, that the heap keeps
+ * in sync. handle_insert(x) runs once x is linked in, handle_erase(x) once it
+ * is unlinked, handle_rekey_begin(x) and handle_rekey_end(x) around a change
+ * of its key, handle_clear() when all nodes go and handle_reserve(n) before n
+ * are indexed. A copied policy only keeps its settings: the heap copy indexes
+ * its own nodes when enabled. fib_no_handles keeps no index; see
+ * fib_key_handles in fiboqueue.h and fib_id_handles in fiboidqueue.h.
+ */
+struct fib_no_handles
+{
+  static const bool enabled = false;
+
+  template<class Node>
+  void handle_insert(Node*)
+  {
+  }
+
+  template<class Node>
+  void handle_erase(Node*)
+  {
+  }
+
+  template<class Node>
+  void handle_rekey_begin(Node*)
+  {
+  }
+
+  template<class Node>
+  void handle_rekey_end(Node*)
+  {
+  }
+
+  void handle_clear()
+  {
+  }
+
+  void handle_reserve(std::size_t)
+  {
+  }
+};
+
+/*
+ * With Stable, elements with equal keys come out in insertion order: insert()
+ * stamps a sequence number into the node, which is only compared on key ties.
+ * Payload is the type of the value stored inline in each node, void for none.
+ * Nodes are allocated with Alloc rebound to FibNode, see fibohugepage.h.
+ * Stats receives the hooks of fib_no_stats, Parallel those of fib_no_parallel
+ * and Handles those of fib_no_handles. The comparator, allocator, sequence
+ * counter and policies are empty bases unless they hold state, so that
+ * FibHeap<int> is no larger than its size and minimum.
+ */
+template<class T, class Comp = std::less<T>, bool Stable = false, class Payload = void*, class Alloc = std::allocator<T>, class Stats = fib_no_stats,
+	 class Parallel = fib_no_parallel, class Handles = fib_no_handles>
+class FibHeap
+  : public fib_compare<Comp>,
+    public fib_node_storage<typename std::allocator_traits<Alloc>::template rebind_alloc<fib_node<T, Payload> > >,
+    public fib_sequence<Stable>,
+    public Stats,
+    public Parallel,
+    public Handles
+{
+ public:
+  typedef typename std::conditional<std::is_void<Payload>::value, fib_no_payload, Payload>::type payload_type;
+
+  typedef fib_node<T, Payload> FibNode;
+
+  typedef typename std::allocator_traits<Alloc>::template rebind_alloc<FibNode> node_allocator;
+  typedef std::allocator_traits<node_allocator> node_traits;
+  typedef fib_compare<Comp> compare_base;
+  typedef fib_node_storage<node_allocator> storage_base;
+  typedef fib_sequence<Stable> sequence_base;
+
+  FibHeap() : FibHeap(Comp())
     {
     }
 
-    ~FibNode()
+  FibHeap(const Comp &comp, const Alloc &a = Alloc(), const Handles &h = Handles())
+      :compare_base(comp), storage_base(node_allocator(a)), Handles(h),
+       n(0), min(nullptr)
+  {
+  }
+
+  /*
+   * deep copy: same keys, payloads and forest shape, in new nodes.
+   */
+  FibHeap(const FibHeap &o)
+    :compare_base(o), storage_base(node_traits::select_on_container_copy_construction(o.node_alloc())),
+     sequence_base(o), Stats(o), Parallel(o), Handles(o),
+     n(0), min(nullptr)
+  {
+    copy_nodes(o, std::integral_constant<bool, fib_block_clone<node_allocator>::enabled
+	       && std::is_trivially_copyable<FibNode>::value>());
+    if ( Handles::enabled )
+      index_handles();
+  }
+
+  FibHeap(FibHeap &&o) noexcept
+    :compare_base(std::move(o)), storage_base(o.node_alloc()), sequence_base(o), Stats(o), Parallel(std::move(o)),
+     Handles(std::move(o)), n(o.n), min(o.min)
+  {
+    o.min = nullptr;
+    o.n = 0;
+  }
+
+  FibHeap& operator=(const FibHeap &o)
+  {
+    if (this != &o)
       {
+	FibHeap tmp(o);
+	swap(tmp);
       }
+    return *this;
+  }
 
-    T key;
-    bool mark;
-    FibNode *p;
-    FibNode *left;
-    FibNode *right;
-    FibNode *child;
-    int degree;
-    void *payload;
-  }; // end FibNode
+  FibHeap& operator=(FibHeap &&o) noexcept
+  {
+    if (this != &o)
+      {
+	clear();
+	swap(o);
+      }
+    return *this;
+  }
 
-  FibHeap() : FibHeap(std::less<T>())
-    {
-    }
+  void swap(FibHeap &o)
+  {
+    std::swap(n, o.n);
+    std::swap(min, o.min);
+    std::swap(static_cast<compare_base&>(*this), static_cast<compare_base&>(o));
+    std::swap(static_cast<storage_base&>(*this), static_cast<storage_base&>(o));
+    std::swap(static_cast<sequence_base&>(*this), static_cast<sequence_base&>(o));
+    std::swap(static_cast<Stats&>(*this), static_cast<Stats&>(o));
+    std::swap(static_cast<Parallel&>(*this), static_cast<Parallel&>(o));
+    std::swap(static_cast<Handles&>(*this), static_cast<Handles&>(o));
+  }
 
-  FibHeap(Comp comp)
-      :n(0), min(nullptr), comp(comp)
+  FibHeap clone() const
   {
+    return FibHeap(*this);
   }
 
   ~FibHeap()
@@ -71,6 +530,7 @@ class FibHeap
       delete_fibnodes(min);
       min = nullptr;
       n = 0;
+      this->handle_clear();
   }
 
   void delete_fibnodes(FibNode *x)
@@ -83,6 +543,8 @@ class FibHeap
       {
 	/*std::cerr << "cur: " << cur << std::endl;
 	  std::cerr << "x: " << x << std::endl;*/
+	// the next sibling loads while the subtree below cur is freed.
+	FIB_PREFETCH(cur->left);
 	if (cur->left && cur->left != x)
 	  {
 	    //std::cerr << "cur left: " << cur->left << std::endl;
@@ -90,13 +552,13 @@ class FibHeap
 	    cur = cur->left;
 	    if (tmp->child)
 	      delete_fibnodes(tmp->child);
-	    delete tmp;
+	    destroy_node(tmp);
 	  }
 	else
 	  {
 	    if (cur->child)
 	      delete_fibnodes(cur->child);
-	    delete cur;
+	    destroy_node(cur);
 	    break;
 	  }
       }
@@ -126,6 +588,9 @@ class FibHeap
     x->child = nullptr;
     // 4
     x->mark = false;
+    if ( Stable )
+      x->seq = this->stamp();
+    this->on_insert();
     // 5
     if ( min == nullptr)
       {
@@ -140,7 +605,7 @@ class FibHeap
 	min->left = x;
 	x->right = min;
 	// 9
-	if ( comp(x->key, min->key) )
+	if ( less(x, min) )
 	  {
 	    // 10
 	    min = x;
@@ -148,6 +613,7 @@ class FibHeap
       }
     // 11
     ++n;
+    this->handle_insert(x);
   }
 
   /*
@@ -171,7 +637,8 @@ class FibHeap
   static FibHeap* union_fibheap(FibHeap *H1, FibHeap *H2)
   {
     // 1
-    FibHeap* H = new FibHeap();
+    FibHeap* H = new FibHeap(H1->key_comp(), H1->node_alloc(), *H1);
+    static_cast<Parallel&>(*H) = *H1;
     // 2
     H->min = H1->min;
     // 3
@@ -183,13 +650,17 @@ class FibHeap
 	H2->min->left = H->min;
       }
     // 4
-    if ( H1->min == nullptr || ( H2->min != nullptr && H1->comp(H2->min->key, H1->min->key) ) )
+    if ( H1->min == nullptr || ( H2->min != nullptr && H1->less(H2->min, H1->min) ) )
       {
 	// 5
 	H->min = H2->min;
       }
     // 6
     H->n = H1->n + H2->n;
+    H->advance_sequence(H1->next_sequence());
+    H->advance_sequence(H2->next_sequence());
+    if ( Handles::enabled )
+      H->index_handles();
     // 7
     return H;
   }
@@ -211,38 +682,15 @@ class FibHeap
    */
   FibNode* extract_min()
   {
-    FibNode *z, *x, *next;
-    FibNode ** childList;
+    FibNode *z;
 
     // 1
     z = min;
     // 2
     if ( z != nullptr )
       {
-	// 3
-	x = z->child;
-	if ( x != nullptr )
-	  {
-	    childList = new FibNode*[z->degree];
-	    next = x;
-	    for ( int i = 0; i < (int)z->degree; i++ )
-	      {
-		childList[i] = next;
-		next = next->right;
-	      }
-	    for ( int i = 0; i < (int)z->degree; i++ )
-	      {
-		x = childList[i];
-		// 4
-		min->left->right = x;
-		x->left = min->left;
-		min->left = x;
-		x->right = min;
-		// 5
-		x->p = nullptr;
-	      }
-	    delete [] childList;
-	  }
+	// 3, 4, 5: the children are spliced in after z, in one walk and no copy.
+	promote_children(z);
 	// 6
 	z->left->right = z->right;
 	z->right->left = z->left;
@@ -261,6 +709,8 @@ class FibHeap
 	  }
 	// 11
 	n--;
+	this->on_extract();
+	this->handle_erase(z);
       }
     // 12
     return z;
@@ -295,69 +745,75 @@ class FibHeap
   void consolidate()
   {
     FibNode* w, * next, * x, * y, * temp;
-    FibNode** A, ** rootList;
-    // Max degree <= log base golden ratio of n
-    int d, rootSize;
+    // Max degree <= log base golden ratio of n, which is below 46 for an int n:
+    // A lives on the stack, so that popping allocates nothing.
+    FibNode* A[64];
+    int d;
     int max_degree = static_cast<int>(floor(log(static_cast<double>(n))/log(static_cast<double>(1 + sqrt(static_cast<double>(5)))/2)));
+    int slots = max_degree+2; // plus two both for indexing to max degree and so A[max_degree+1] == NIL
 
-    // 1
-    A = new FibNode*[max_degree+2]; // plus two both for indexing to max degree and so A[max_degree+1] == NIL
-    // 2, 3
-    std::fill_n(A, max_degree+2, nullptr);
+    // 1, 2, 3
+    std::fill_n(A, slots, nullptr);
     // 4
-    w = min;
-    rootSize = 0;
-    next = w;
-    do
-      {
-	rootSize++;
-	next = next->right;
-      } while ( next != w );
-    rootList = new FibNode*[rootSize];
-    for ( int i = 0; i < rootSize; i++ )
-      {
-	rootList[i] = next;
-	next = next->right;
-      }
-    for ( int i = 0; i < rootSize; i++ )
+    std::size_t walked = 0;
+    // 5-14 by the parallel policy, on slices of the root list.
+    if ( !this->link_roots(*this, min, A, slots, walked) )
       {
-	w = rootList[i];
-	// 5
-	x = w;
-	// 6
-	d = x->degree;
-	// 7
-	while ( A[d] != nullptr )
+	// the root list is walked once, in place: linking with make_child()
+	// leaves the right links of the roots not yet visited untouched, and
+	// the list is rebuilt from A below.
+	w = min;
+	FibNode *scout = prefetch_ahead(w, FIBOHEAP_PREFETCH_DISTANCE);
+	do
 	  {
-	    // 8
-	    y = A[d];
-	    // 9
-	    if ( comp(y->key, x->key) )
+	    next = w->right;
+	    if ( FIBOHEAP_PREFETCH_DISTANCE )
 	      {
-		// 10
-		temp = x;
-		x = y;
-		y = temp;
+		// the root DISTANCE steps ahead, and the A[d] slot next will probe.
+		scout = prefetch_ahead(scout, 1);
+		if ( next != min && A[next->degree] != nullptr )
+		  FIB_PREFETCH_W(A[next->degree]);
 	      }
-	    // 11
-	    fib_heap_link(y,x);
-	    // 12
-	    A[d] = nullptr;
-	    // 13
-	    d++;
-	  }
-	// 14
-	A[d] = x;
+	    walked++;
+	    // 5
+	    x = w;
+	    // 6
+	    d = x->degree;
+	    // 7
+	    while ( A[d] != nullptr )
+	      {
+		// 8
+		y = A[d];
+		// 9
+		if ( less(y, x) )
+		  {
+		    // 10
+		    temp = x;
+		    x = y;
+		    y = temp;
+		  }
+		// 11
+		make_child(y,x);
+		// 12
+		A[d] = nullptr;
+		// 13
+		d++;
+	      }
+	    // 14
+	    A[d] = x;
+	    w = next;
+	  } while ( w != min );
       }
-    delete [] rootList;
     // 15
     min = nullptr;
+    std::size_t roots = 0;
     // 16
-    for ( int i = 0; i < max_degree+2; i++ )
+    for ( int i = 0; i < slots; i++ )
       {
 	// 17
 	if ( A[i] != nullptr )
 	  {
+	    roots++;
 	    // 18
 	    if ( min == nullptr )
 	      {
@@ -372,7 +828,7 @@ class FibHeap
 		min->left = A[i];
 		A[i]->right = min;
 		// 22
-		if ( comp(A[i]->key, min->key) )
+		if ( less(A[i], min) )
 		  {
 		    // 23
 		    min = A[i];
@@ -380,7 +836,8 @@ class FibHeap
 	      }
 	  }
       }
-    delete [] A;
+    // every link took one root off the list.
+    this->on_consolidate(walked, walked - roots);
   }
 
 /*
@@ -394,9 +851,17 @@ class FibHeap
     // 1
     y->left->right = y->right;
     y->right->left = y->left;
-    // 2
-    if ( x->child != nullptr )
-      {
+    make_child(y,x);
+  }
+
+  /*
+   * steps 2 and 3 of fib_heap_link, leaving y's old siblings untouched.
+   */
+  void make_child( FibNode* y, FibNode* x )
+  {
+    // 2
+    if ( x->child != nullptr )
+      {
 	x->child->left->right = y;
 	y->left = x->child->left;
 	x->child->left = y;
@@ -432,18 +897,20 @@ class FibHeap
     FibNode* y;
 
     // 1
-    if ( comp(x->key, k) )
+    if ( this->comp(x->key, k) )
       {
 	// 2
 	// error( "new key is greater than current key" );
 	return;
       }
     // 3
+    this->handle_rekey_begin(x);
     x->key = std::move(k);
+    this->handle_rekey_end(x);
     // 4
     y = x->p;
     // 5
-    if ( y != nullptr && comp(x->key, y->key) )
+    if ( y != nullptr && less(x, y) )
       {
 	// 6
 	cut(x,y);
@@ -451,13 +918,79 @@ class FibHeap
 	cascading_cut(y);
       }
     // 8
-    if ( comp(x->key, min->key) )
+    if ( less(x, min) )
       {
 	// 9
 	min = x;
       }
   }
 
+  /*
+   * increase_key(x,k)
+   * 1. if k < x.key
+   * 2. 	error "new key is smaller than current key"
+   * 3. x.key = k
+   * 4. y = x.p
+   * 5. if y != NIL
+   * 6. 	CUT(H,x,y)
+   * 7. 	CASCADING-CUT(H,y)
+   * 8. add each child of x to the root list of H
+   * 9. if x == H.min and x != x.right
+   *10. 	CONSOLIDATE(H)
+   */
+  void increase_key( FibNode* x, T k )
+  {
+    FibNode* y;
+
+    // 1
+    if ( this->comp(k, x->key) )
+      {
+	// 2
+	// error( "new key is smaller than current key" );
+	return;
+      }
+    // 3
+    this->handle_rekey_begin(x);
+    x->key = std::move(k);
+    this->handle_rekey_end(x);
+    // 4
+    y = x->p;
+    // 5
+    if ( y != nullptr )
+      {
+	// 6
+	cut(x,y);
+	// 7
+	cascading_cut(y);
+      }
+    // 8
+    promote_children(x);
+    // 9
+    if ( x == min && x != x->right )
+      {
+	// 10
+	consolidate();
+      }
+  }
+
+  /*
+   * update_key(x,k)
+   * changes the key of x in either direction, x stays a valid handle.
+   */
+  void update_key( FibNode* x, T k )
+  {
+    if ( this->comp(k, x->key) )
+      decrease_key(x,std::move(k));
+    else if ( this->comp(x->key, k) )
+      increase_key(x,std::move(k));
+    else
+      {
+	this->handle_rekey_begin(x);
+	x->key = std::move(k);
+	this->handle_rekey_end(x);
+      }
+  }
+
   /*
    * cut(x,y)
    * 1. remove x from the child list of y, decrementing y.degree
@@ -491,6 +1024,7 @@ class FibHeap
     x->p = nullptr;
     // 4
     x->mark = false;
+    this->on_cut();
   }
 
 /*
@@ -528,13 +1062,187 @@ class FibHeap
   }
 
   /*
-   * set to infinity so that it hits the top of the heap, then easily remove.
+   * unlink_fibnode(x)
+   * removes x from the heap without freeing it, so that it can be reinserted.
+   * 1. y = x.p
+   * 2. if y != NIL
+   * 3. 	CUT(H,x,y)
+   * 4. 	CASCADING-CUT(H,y)
+   * 5. add each child of x to the root list of H
+   * 6. remove x from the root list of H
+   * 7. if x == H.min
+   * 8. 	if x == x.right
+   * 9. 		H.min = NIL
+   *10. 	else H.min = x.right
+   *11. 		CONSOLIDATE(H)
+   *12. H.n = H.n - 1
+   */
+  void unlink_fibnode( FibNode* x )
+  {
+    FibNode* y;
+
+    // 1
+    y = x->p;
+    // 2
+    if ( y != nullptr )
+      {
+	// 3
+	cut(x,y);
+	// 4
+	cascading_cut(y);
+      }
+    // 5
+    promote_children(x);
+    // 6
+    x->left->right = x->right;
+    x->right->left = x->left;
+    // 7
+    if ( x == min )
+      {
+	// 8
+	if ( x == x->right )
+	  {
+	    // 9
+	    min = nullptr;
+	  }
+	else
+	  {
+	    // 10
+	    min = x->right;
+	    // 11
+	    consolidate();
+	  }
+      }
+    // 12
+    n--;
+    x->left = x->right = x;
+    this->handle_erase(x);
+  }
+
+  /*
+   * moves a scout steps nodes to the right, prefetching each one: a scout
+   * kept FIBOHEAP_PREFETCH_DISTANCE nodes ahead of a walk along a ring has
+   * every node requested that many steps before the walk reaches it. Nodes
+   * behind the walk stay valid, so the scout may wrap around the ring.
+   */
+  static FibNode* prefetch_ahead( FibNode* scout, int steps )
+  {
+    for ( int i = 0; i < steps; i++ )
+      {
+	scout = scout->right;
+	FIB_PREFETCH_W(scout);
+      }
+    return scout;
+  }
+
+  /*
+   * splice the children of root x into the root list, right after x.
+   */
+  void promote_children( FibNode* x )
+  {
+    FibNode *c = x->child;
+    if ( c == nullptr )
+      return;
+    FibNode *w = c;
+    FibNode *scout = prefetch_ahead(c, FIBOHEAP_PREFETCH_DISTANCE);
+    do
+      {
+	if ( FIBOHEAP_PREFETCH_DISTANCE )
+	  scout = prefetch_ahead(scout, 1);
+	w->p = nullptr;
+	w = w->right;
+      } while ( w != c );
+    FibNode *last = c->left;
+    last->right = x->right;
+    x->right->left = last;
+    x->right = c;
+    c->left = x;
+    x->child = nullptr;
+    x->degree = 0;
+  }
+
+  /*
+   * unlink x, then free it.
    */
   void remove_fibnode( FibNode* x )
   {
-    decrease_key(x,std::numeric_limits<T>::min());
-    FibNode *fn = extract_min();
-    delete fn;
+    unlink_fibnode(x);
+    destroy_node(x);
+  }
+
+  /*
+   * removes and frees every node x for which pred(x) holds, and returns how
+   * many. The nodes are found in one walk of the forest and unlinked with
+   * cuts only, their children joining the root list, so that the heap is
+   * consolidated once at the end instead of once per node.
+   */
+  template<class Pred>
+  std::size_t erase_if(Pred pred)
+  {
+    std::vector<FibNode*> doomed;
+    for_each_node([&doomed, &pred](FibNode *x) {
+	if (pred(x))
+	  doomed.push_back(x);
+      });
+    for (FibNode *x : doomed)
+      {
+	FibNode *y = x->p;
+	if ( y != nullptr )
+	  {
+	    cut(x,y);
+	    cascading_cut(y);
+	  }
+	promote_children(x);
+	x->left->right = x->right;
+	x->right->left = x->left;
+	// min only needs to stay on the root list until consolidate() below.
+	if ( x == min )
+	  min = x == x->right ? nullptr : x->right;
+	n--;
+	this->handle_erase(x);
+	destroy_node(x);
+      }
+    if ( !doomed.empty() && min != nullptr )
+      consolidate();
+    return doomed.size();
+  }
+
+  /*
+   * extract_n(k) removes the (at most) k nodes that k extract_min() calls
+   * would, and returns them in that order. They are found with the frontier
+   * of peek_n(), and as parents come before their children there, each one
+   * is a root by the time it is unlinked: its children join the root list
+   * and the heap is consolidated once at the end, instead of once per node.
+   */
+  std::vector<FibNode*> extract_n(std::size_t k)
+  {
+    std::vector<FibNode*> nodes = peek_n(k);
+    for (FibNode *x : nodes)
+      {
+	promote_children(x);
+	x->left->right = x->right;
+	x->right->left = x->left;
+	// min only needs to stay on the root list until consolidate() below.
+	if ( x == min )
+	  min = x == x->right ? nullptr : x->right;
+	x->left = x->right = x;
+	n--;
+	this->on_extract();
+      }
+    // the handles go one by one, or all at once when the heap is emptied.
+    if ( n == 0 )
+      this->handle_clear();
+    else
+      for (FibNode *x : nodes)
+	this->handle_erase(x);
+    if ( !nodes.empty() && min != nullptr )
+      consolidate();
+    return nodes;
+  }
+
+  const Stats& stats() const
+  {
+    return *this;
   }
 
   /*
@@ -555,25 +1263,102 @@ class FibHeap
     return minimum()->key;
   }
 
+  template<class P = Payload>
+  typename std::enable_if<!std::is_void<P>::value, P&>::type top_value()
+  {
+    return minimum()->payload;
+  }
+
   void pop()
   {
     if (empty())
       return;
     FibNode *x = extract_min();
     if (x)
-      delete x;
+      destroy_node(x);
   }
 
-  FibNode* push(T k, void *pl)
+  /*
+   * pops (at most) k keys into out in pop order, with a single consolidation,
+   * and returns the end of the output. If writing a key throws, the rest of
+   * the batch, already out of the heap, is freed before rethrowing.
+   */
+  template<class OutputIt>
+  OutputIt pop_n(std::size_t k, OutputIt out)
+  {
+    std::vector<FibNode*> nodes = extract_n(k);
+    std::size_t i = 0;
+    try
+      {
+	for (; i < nodes.size(); i++)
+	  {
+	    *out++ = std::move(nodes[i]->key);
+	    destroy_node(nodes[i]);
+	  }
+      }
+    catch (...)
+      {
+	for (; i < nodes.size(); i++)
+	  destroy_node(nodes[i]);
+	throw;
+      }
+    return out;
+  }
+
+  /*
+   * replaces the top key and restores the heap order in place, the same as
+   * pop() then push() but the node, its payload and handle are kept.
+   */
+  void replace_top(T k)
   {
-    FibNode *x = new FibNode(std::move(k),pl);
+    update_key(min,std::move(k));
+  }
+
+  FibNode* push(T k, payload_type pl)
+  {
+    return emplace(std::move(k),std::move(pl));
+  }
+
+  FibNode* push(T k)
+  {
+    return emplace(std::move(k));
+  }
+
+  /*
+   * constructs the payload in place from args.
+   */
+  template<class... Args>
+  FibNode* emplace(T k, Args&&... args)
+  {
+    FibNode *x = create_node(std::move(k),std::forward<Args>(args)...);
     insert(x);
     return x;
   }
 
-  FibNode* push(T k)
+  /*
+   * allocates and constructs a node outside of the heap, for insert().
+   * Nodes given back by extract_min() are freed with destroy_node().
+   */
+  template<class... Args>
+  FibNode* create_node(T k, Args&&... args)
+  {
+    FibNode *x = node_traits::allocate(this->node_alloc(), 1);
+    try
+      {
+	node_traits::construct(this->node_alloc(), x, std::move(k), std::forward<Args>(args)...);
+      }
+    catch (...)
+      {
+	node_traits::deallocate(this->node_alloc(), x, 1);
+	throw;
+      }
+    return x;
+  }
+
+  void destroy_node(FibNode *x)
   {
-    return push(std::move(k),nullptr);
+    node_traits::destroy(this->node_alloc(), x);
+    node_traits::deallocate(this->node_alloc(), x, 1);
   }
 
   unsigned int size()
@@ -581,10 +1366,296 @@ class FibHeap
     return (unsigned int) n;
   }
 
+  /*
+   * walks the heap in pop order without modifying it. A frontier heap holds
+   * the roots, then the children of every node handed out, so the first k
+   * steps cost O(r + k log(r + k)) for r roots. Any change to the heap
+   * invalidates the iterator.
+   */
+  class ordered_iterator
+  {
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    ordered_iterator()
+      :heap(nullptr)
+    {
+    }
+
+    explicit ordered_iterator(const FibHeap *h)
+      :heap(h)
+    {
+      if (h->min)
+	{
+	  push_ring(h->min);
+	  std::make_heap(frontier.begin(), frontier.end(), after(heap));
+	}
+    }
+
+    reference operator*() const
+    {
+      return frontier.front()->key;
+    }
+
+    pointer operator->() const
+    {
+      return &frontier.front()->key;
+    }
+
+    FibNode* node() const
+    {
+      return frontier.front();
+    }
+
+    ordered_iterator& operator++()
+    {
+      std::pop_heap(frontier.begin(), frontier.end(), after(heap));
+      FibNode *x = frontier.back();
+      frontier.pop_back();
+      if (x->child)
+	{
+	  std::size_t first = frontier.size();
+	  push_ring(x->child);
+	  for (std::size_t i = first; i < frontier.size(); i++)
+	    std::push_heap(frontier.begin(), frontier.begin() + i + 1, after(heap));
+	}
+      return *this;
+    }
+
+    void operator++(int)
+    {
+      ++*this;
+    }
+
+    bool operator==(const ordered_iterator &o) const
+    {
+      return frontier.empty() && o.frontier.empty();
+    }
+
+    bool operator!=(const ordered_iterator &o) const
+    {
+      return !(*this == o);
+    }
+
+  private:
+    // max-heap order for std::push_heap, so that the front is the minimum.
+    struct after
+    {
+      after(const FibHeap *h)
+	:h(h)
+      {
+      }
+
+      bool operator()(FibNode *x, FibNode *y) const
+      {
+	return h->less(y, x);
+      }
+
+      const FibHeap *h;
+    };
+
+    void push_ring(FibNode *x)
+    {
+      FibNode *w = x;
+      do
+	{
+	  frontier.push_back(w);
+	  w = w->right;
+	} while (w != x);
+    }
+
+    const FibHeap *heap;
+    std::vector<FibNode*> frontier;
+  };
+
+  ordered_iterator ordered_begin() const
+  {
+    return ordered_iterator(this);
+  }
+
+  ordered_iterator ordered_end() const
+  {
+    return ordered_iterator();
+  }
+
+  /*
+   * the (at most) k nodes that pop() would return next, in that order.
+   */
+  std::vector<FibNode*> peek_n(std::size_t k) const
+  {
+    std::vector<FibNode*> out;
+    out.reserve(k < static_cast<std::size_t>(n) ? k : n);
+    if (k == 0)
+      return out;
+    for (ordered_iterator it = ordered_begin(); it != ordered_end(); ++it)
+      {
+	out.push_back(it.node());
+	if (out.size() == k)
+	  break;
+      }
+    return out;
+  }
+
+  /*
+   * calls f(x) on every node in no particular order, f must not change keys.
+   */
+  template<class F>
+  void for_each_node(F f) const
+  {
+    if (!min)
+      return;
+    std::vector<FibNode*> rings(1, min);
+    while (!rings.empty())
+      {
+	FibNode *first = rings.back();
+	rings.pop_back();
+	FibNode *w = first;
+	do
+	  {
+	    if (w->child)
+	      rings.push_back(w->child);
+	    f(w);
+	    w = w->right;
+	  } while (w != first);
+      }
+  }
+
+  /*
+   * node order: by key, then by insertion in stable mode.
+   */
+  bool less( FibNode* x, FibNode* y ) const
+  {
+    if ( this->comp(x->key, y->key) )
+      return true;
+    if ( Stable && !this->comp(y->key, x->key) )
+      return x->seq < y->seq;
+    return false;
+  }
+
+  /*
+   * indexes every node with the handle policy, as after a copy.
+   */
+  void index_handles()
+  {
+    this->handle_clear();
+    this->handle_reserve(n);
+    for_each_node([this](FibNode *x){ this->handle_insert(x); });
+  }
+
+  /*
+   * consolidate steps 5-14 for one root x.
+   */
+  void carry_root( FibNode **A, FibNode *x )
+  {
+    int d = x->degree;
+    while ( A[d] != nullptr )
+      {
+	FibNode *y = A[d];
+	if ( less(y, x) )
+	  std::swap(x, y);
+	make_child(y,x);
+	A[d] = nullptr;
+	d++;
+      }
+    A[d] = x;
+  }
+
+  /*
+   * copies o's forest one sibling ring at a time, in a single pass with no
+   * lookup table: a ring is copied when its parent's copy exists, and every
+   * copy is linked in right away so that clear() can undo a throwing copy.
+   * Each copy is allocated on its own, as pop() and remove_fibnode() free
+   * nodes one at a time, which no allocator allows for part of an n-node
+   * block; allocators that keep their nodes in blocks copy them wholesale
+   * through fib_block_clone instead.
+   */
+  void copy_nodes( const FibHeap &o, std::false_type )
+  {
+    if ( o.min == nullptr )
+      return;
+    // (first node of a ring in o, copy of their parent)
+    std::vector<std::pair<FibNode*, FibNode*> > rings(1, std::make_pair(o.min, static_cast<FibNode*>(nullptr)));
+    try
+      {
+	while ( !rings.empty() )
+	  {
+	    FibNode *first = rings.back().first, *parent = rings.back().second;
+	    rings.pop_back();
+	    FibNode *head = nullptr, *w = first;
+	    do
+	      {
+		FibNode *y = node_traits::allocate(this->node_alloc(), 1);
+		try
+		  {
+		    node_traits::construct(this->node_alloc(), y, *w);
+		  }
+		catch (...)
+		  {
+		    node_traits::deallocate(this->node_alloc(), y, 1);
+		    throw;
+		  }
+		y->p = parent;
+		y->child = nullptr;
+		if ( head == nullptr )
+		  {
+		    head = y->left = y->right = y;
+		    if ( parent )
+		      parent->child = y;
+		    else
+		      min = y;
+		  }
+		else
+		  {
+		    y->right = head;
+		    y->left = head->left;
+		    head->left->right = y;
+		    head->left = y;
+		  }
+		n++;
+		if ( w->child )
+		  rings.push_back(std::make_pair(w->child, y));
+		w = w->right;
+	      } while ( w != first );
+	  }
+      }
+    catch (...)
+      {
+	clear();
+	throw;
+      }
+  }
+
+  /*
+   * copies the allocator's blocks, then rebases the links of every node.
+   */
+  void copy_nodes( const FibHeap &o, std::true_type )
+  {
+    if ( o.min == nullptr )
+      return;
+    auto rebase = fib_block_clone<node_allocator>::clone(o.node_alloc(), this->node_alloc());
+    rebase.for_each_copy([&rebase](FibNode *y) {
+	y->p = rebase(y->p);
+	y->left = rebase(y->left);
+	y->right = rebase(y->right);
+	y->child = rebase(y->child);
+      }, [&o](const std::function<void(FibNode*)> &g) { o.for_each_node(g); });
+    min = rebase(o.min);
+    n = o.n;
+  }
+
   int n;
   FibNode *min;
-  Comp comp;
 
 };
 
+/*
+ * heap storing a Value inline in each node instead of a void* payload.
+ */
+template<class Key, class Value, class Comp = std::less<Key>>
+using TypedFibHeap = FibHeap<Key, Comp, false, Value>;
+
 #endif
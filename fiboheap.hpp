@@ -16,296 +16,30 @@
  * License along with this library.
  */
 
-/*
- * @note sizeof(Node) = 136, sizeof(c_node) = 56
+/**
+ * Former fibonacci_heap<T> API over FibHeap<T> in fiboheap.h, whose nodes
+ * hold a T key rather than a void* to one. fibonacci_heap<T>::c_node is the
+ * node of a heap, and the c_node of the namespace, which was not a template,
+ * the node of fibonacci_heap<int>. create_c_node_on_heap() and remove_c_node()
+ * forward to push() and remove_fibnode().
  */
 
 #ifndef FIBOHEAP_HPP
 #define FIBOHEAP_HPP
 
-#include <algorithm>
-#include <cstddef>
-#include <cmath>
-#include <limits>
-#include <iostream>
-#include <utility>
-#include <vector>
-
-namespace fibonacci_heap {
-	extern "C" {
-		typedef struct c_node {
-			// The order of the attributes matter, changing it may result in a larger memory consumption. See "memory alignment in C".
-			void* key = nullptr, *payload = nullptr;
-			c_node* p = nullptr, *left = nullptr, *right = nullptr, *child = nullptr;
-			int degree = -1;
-			bool mark = false;
-		} c_node;
-		c_node* create_c_node_on_heap(void* _key, void* _payload) {
-			// création de l'élément
-			c_node* node = (c_node*)malloc(sizeof(c_node));
-			// initialisation des membres
-			node->key = _key;
-			node->payload = _payload;
-
-			return node;
-		}
-	}
-}
+#include "fiboheap.h"
 
 namespace fibonacci_heap {
 	template<class T>
-	class fibonacci_heap {
-		/* attributes */
-			private:
-				size_t n;
-				c_node* min;
-		/* members */
-			public:
-				// constructors
-					fibonacci_heap() : n(0), min(nullptr) { }
-					fibonacci_heap(const fibonacci_heap& other) : n(other.n), min(other.min) {}
-					fibonacci_heap(fibonacci_heap&& other) noexcept : n(other.n), min(other.min) { delete_nodes(other.min); }
-				// destructor
-					~fibonacci_heap() noexcept { delete_nodes(min); }
-				// operators
-					fibonacci_heap& operator=(const fibonacci_heap& other) {
-						n = other.n;
-						min = other.min;
-					}
-					fibonacci_heap& operator=(fibonacci_heap&& other) noexcept {
-						n = other.n;
-						min = other.min;
-						delete_nodes(other.min);
-					}
-				// getters
-					bool empty() const noexcept { return n == 0; }
-					size_t size() const noexcept { return n; }
-				// accessors
-					c_node* topNode() const { return minimum(); }
-					T top() {
-						std::cout << "\ttop " << to_T(minimum()->key) << " address " << &minimum()->key << std::endl;
-						return to_T(minimum()->key);
-					}
-					[[time_complexity::Θ(1)]] c_node* minimum() const { return min; }
-					c_node* extract_min() {
-						c_node* z = min;
-
-						if(c_node* x, *next; z != nullptr) {
-							if(z->child != nullptr) {
-								std::vector<c_node*> childList(z->degree);
-								next = x = z->child;
-
-								for_each(childList.begin(), childList.end(),
-									[](auto& element) {
-										element = element->right;
-									}
-								);
-
-								for(auto i = 0; i < z->degree; ++i) {
-									min->left->right = x = childList.at(i);
-									x->left = min->left;
-									min->left = x;
-									x->right = min;
-									x->p = nullptr;
-								}
-							}
-							z->left->right = z->right;
-							z->right->left = z->left;
-							if(z == z->right)
-								min = nullptr;
-							else {
-								min = z->right;
-								consolidate();
-							}
-							--n;
-						}
-						return z;
-					}
-				// modifiers
-					void pop() {
-						if(empty())
-							return;
-						if(c_node* x = extract_min();  x)
-							delete x;
-					}
-					[[time_complexity::Θ(1)]] c_node* insert(c_node* x) {
-						std::cout << "\tinsert key " << to_T(x->key) << std::endl;
-						x->degree = 0;
-						x->child = x->p = nullptr;
-						x->mark = false;
-						if(min == nullptr)
-							min = x->left = x->right = x;
-						else {
-							min->left->right = x;
-							x->left = min->left;
-							min->left = x;
-							x->right = min;
-							if(to_T(&x->key) < to_T(&min->key))
-								min = x;
-						}
-						++n;
-						return x;
-					}
-					[[time_complexity::Θ(1)]] static fibonacci_heap* union_fibheap(fibonacci_heap* H1, fibonacci_heap* H2) {
-						fibonacci_heap* H = new fibonacci_heap();
-						H->min = H1->min;
-						if(H->min != nullptr && H2->min != nullptr) {
-							H2->min->left->right = H->min->right;
-							H->min->right->left = H2->min->left;
-							H->min->right = H2->min;
-							H2->min->left = H->min;
-						}
-						if(H1->min == nullptr || (H2->min != nullptr && to_T(H2->min->key) < to_T(H1->min->key)))
-							H->min = H2->min;
-						H->n = H1->n + H2->n;
-						return H;
-					}
-					[[noreturn]] void cut(c_node* x, c_node* y) {
-						if(x->right == x)
-							y->child = nullptr;
-						else {
-							x->right->left = x->left;
-							x->left->right = x->right;
-							if(y->child == x)
-								y->child = x->right;
-						}
-						--y->degree;
-						min->right->left = x;
-						x->right = min->right;
-						min->right = x;
-						x->left = min;
-						x->p = nullptr;
-						x->mark = false;
-					}
-					[[noreturn]] void cascading_cut(c_node* y) {
-						if(c_node* z = y->p; z != nullptr) {
-							if(!y->mark)
-								y->mark = true;
-							else {
-								cut(y, z);
-								cascading_cut(z);
-							}
-						}
-					}
-					[[noreturn]] void remove_c_node(c_node* x) {
-						decrease_key(x, std::numeric_limits<T>::min());
-						delete extract_min();
-					}
-					[[noreturn]] void fib_heap_link(c_node* y, c_node* x) {
-						y->left->right = y->right;
-						y->right->left = y->left;
-						if(x->child != nullptr) {
-							x->child->left->right = y;
-							y->left = x->child->left;
-							x->child->left = y;
-							y->right = x->child;
-						}
-						else
-							y->left = y->right = x->child = y;
-						y->p = x;
-						++x->degree;
-						y->mark = false;
-					}
-					c_node* push(const T& k, void* pl = nullptr) { return insert(create_c_node_on_heap(to_void_p(k), pl)); }
-					c_node* push(T&& k, void* pl = nullptr) { return insert(create_c_node_on_heap(to_void_p(k), pl)); }
-					[[using time_complexity:Θ(1), amortized]] void decrease_key(c_node* x, T k) {
-						try {
-							if(to_T(&x->key) < k)
-								throw std::out_of_range("new key is greater than current key");
-						}
-						catch(std::out_of_range& e) {
-							e.what();
-							return;
-						}
-						x->key = to_void_p(k);
-						if(c_node* y = x->p; y != nullptr && to_T(&x->key) < to_T(&y->key)) {
-							cut(x, y);
-							cascading_cut(y);
-						}
-						if(to_T(&x->key) < to_T(&min->key))
-							min = x;
-					}
-			protected:
-				[[using time_complexity:O(log n), amortized]] void delete_nodes(c_node* x) {
-					if(!x)
-						return;
-					c_node* cur = x;
-					std::cout << "deleting " << &x << std::endl;
-					while(true) {
-						// cerr << "cur: " << cur << endl << "x: " << x << endl;
-						if(cur->left != nullptr && cur->left != x) {
-							// cerr << "\tcur left: " << cur->left << endl;
-							c_node* tmp = cur;
-							cur = cur->left;
-							if(tmp->child)
-								delete_nodes(tmp->child);
-							delete tmp;
-						}
-						else {
-							if(cur->child)
-								delete_nodes(cur->child);
-							delete cur;
-							break;
-						}
-					}
-				}
-				void consolidate() {
-					if(0 < n)
-						return;
-
-					c_node* w = nullptr, *next = nullptr, *x = nullptr, *y = nullptr;
-					unsigned int rootSize = 0;
-					auto max_degree = static_cast<int>(floor(log(static_cast<double>(n)) / log(static_cast<double>(1 + sqrt(static_cast<double>(5))) / 2)));
-
-					std::vector<c_node*> A(max_degree);
-					fill(A.begin(), A.end(), nullptr);
-					next = w = min;
-					do {
-						++rootSize;
-						next = next->right;
-					} while(next != w);
-
-					std::vector<c_node*> rootList(rootSize);
-					for_each(rootList.begin(), rootList.end(),
-						[](auto& element) {
-							element = element->right;
-						}
-					);
-
-					for(const auto& element : rootList) {
-						x = w = element;
-						auto d = x->degree;
-						while(A.at(d) != nullptr) {
-							y = A.at(d);
-							if(to_T(y->key) < to_T(x->key))
-								std::swap(x, y);
-							fib_heap_link(y, x);
-							A.at(d) = nullptr;
-							++d;
-						}
-						A.at(d) = x;
-					}
-
-					min = nullptr;
-					for(const auto& element : A) {
-						if(element != nullptr) {
-							if(min == nullptr)
-								min = element->left = element->right = element;
-							else {
-								min->left->right = element;
-								element->left = min->left;
-								min->left = element;
-								element->right = min;
-								if(to_T(element->key) < to_T(min->key))
-									min = element;
-							}
-						}
-					}
-				}
-				void* to_void_p(const T& value) const { return static_cast<void*>(static_cast<T*>(const_cast<T*>(&value))); }
-				void* to_void_p(T& value) const { return static_cast<void*>(static_cast<T*>(&value)); }
-				T to_T(void* value) const { return static_cast<T>(*static_cast<T*>(value)); }
+	class fibonacci_heap : public FibHeap<T> {
+		public:
+			typedef typename FibHeap<T>::FibNode c_node;
+			using FibHeap<T>::FibHeap;
+			c_node* create_c_node_on_heap(T k, void* pl = nullptr) { return this->push(std::move(k), pl); }
+			void remove_c_node(c_node* x) { this->remove_fibnode(x); }
 	};
+
+	typedef fibonacci_heap<int>::c_node c_node;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,407 @@
+/**
+ * Fibonacci Heap C API
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * libfiboheap: the C API of fiboheap_c.h over FibHeap.
+ * Build with
+ * g++ -O2 -std=c++11 -shared -fPIC -fvisibility=hidden fiboheap_c.cc -o libfiboheap.so
+ */
+
+#include "fiboheap_c.h"
+#include "fiboheap.h"
+
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+  template<class T>
+  struct c_heap
+  {
+    typedef FibHeap<T> Heap;
+    typedef typename Heap::FibNode Node;
+
+    static Node* node(fibheap_node *x)
+    {
+      return reinterpret_cast<Node*>(x);
+    }
+
+    static fibheap_node* handle(Node *x)
+    {
+      return reinterpret_cast<fibheap_node*>(x);
+    }
+
+    static void* to_payload(uintptr_t pl)
+    {
+      return reinterpret_cast<void*>(pl);
+    }
+
+    static uintptr_t from_payload(void *pl)
+    {
+      return reinterpret_cast<uintptr_t>(pl);
+    }
+
+    static fibheap_node* push(Heap &h, T k, uintptr_t pl)
+    {
+      try
+	{
+	  return handle(h.push(std::move(k), to_payload(pl)));
+	}
+      catch (const std::bad_alloc&)
+	{
+	  return nullptr;
+	}
+    }
+
+    static int top(const Heap &h, T *k, uintptr_t *pl)
+    {
+      if (h.empty())
+	return 0;
+      if (k)
+	*k = h.min->key;
+      if (pl)
+	*pl = from_payload(h.min->payload);
+      return 1;
+    }
+
+    static int pop(Heap &h, T *k, uintptr_t *pl)
+    {
+      if (h.empty())
+	return 0;
+      Node *x = h.extract_min();
+      if (k)
+	*k = std::move(x->key);
+      if (pl)
+	*pl = from_payload(x->payload);
+      h.destroy_node(x);
+      return 1;
+    }
+
+    template<class Key>
+    static size_t push_n(Heap &h, const Key *keys, const uintptr_t *pls, size_t count, fibheap_node **out)
+    {
+      for (size_t i = 0; i < count; i++)
+	{
+	  fibheap_node *x = push(h, keys[i], pls ? pls[i] : 0);
+	  if (!x)
+	    return i;
+	  if (out)
+	    out[i] = x;
+	}
+      return count;
+    }
+
+    /*
+     * the k nodes are extracted with a single consolidation.
+     */
+    static size_t pop_n(Heap &h, size_t k, T *keys, uintptr_t *pls)
+    {
+      std::vector<Node*> nodes;
+      try
+	{
+	  nodes = h.extract_n(k);
+	}
+      catch (const std::bad_alloc&)
+	{
+	  return 0;
+	}
+      for (size_t i = 0; i < nodes.size(); i++)
+	{
+	  keys[i] = std::move(nodes[i]->key);
+	  if (pls)
+	    pls[i] = from_payload(nodes[i]->payload);
+	  h.destroy_node(nodes[i]);
+	}
+      return nodes.size();
+    }
+
+    static void update_key(Heap &h, fibheap_node *x, T k)
+    {
+      h.update_key(node(x), std::move(k));
+    }
+
+    static void remove(Heap &h, fibheap_node *x)
+    {
+      h.remove_fibnode(node(x));
+    }
+  };
+
+  typedef c_heap<int64_t> i64_heap;
+  typedef c_heap<double> f64_heap;
+  typedef c_heap<std::string> bytes_heap;
+
+  std::string to_bytes(const void *key, size_t len)
+  {
+    return std::string(static_cast<const char*>(key), len);
+  }
+}
+
+struct fibheap_i64
+{
+  i64_heap::Heap heap;
+};
+
+struct fibheap_f64
+{
+  f64_heap::Heap heap;
+};
+
+struct fibheap_bytes
+{
+  bytes_heap::Heap heap;
+};
+
+extern "C" {
+
+int fibheap_abi_version(void)
+{
+  return FIBHEAP_ABI_VERSION;
+}
+
+/* int64 keys */
+
+fibheap_i64* fibheap_i64_create(void)
+{
+  return new (std::nothrow) fibheap_i64();
+}
+
+void fibheap_i64_destroy(fibheap_i64 *h)
+{
+  delete h;
+}
+
+size_t fibheap_i64_size(const fibheap_i64 *h)
+{
+  return static_cast<size_t>(h->heap.n);
+}
+
+fibheap_node* fibheap_i64_push(fibheap_i64 *h, int64_t key, uintptr_t payload)
+{
+  return i64_heap::push(h->heap, key, payload);
+}
+
+size_t fibheap_i64_push_n(fibheap_i64 *h, const int64_t *keys, const uintptr_t *payloads,
+			  size_t count, fibheap_node **nodes_out)
+{
+  return i64_heap::push_n(h->heap, keys, payloads, count, nodes_out);
+}
+
+int fibheap_i64_top(const fibheap_i64 *h, int64_t *key, uintptr_t *payload)
+{
+  return i64_heap::top(h->heap, key, payload);
+}
+
+int fibheap_i64_pop(fibheap_i64 *h, int64_t *key, uintptr_t *payload)
+{
+  return i64_heap::pop(h->heap, key, payload);
+}
+
+size_t fibheap_i64_pop_n(fibheap_i64 *h, size_t k, int64_t *keys, uintptr_t *payloads)
+{
+  return i64_heap::pop_n(h->heap, k, keys, payloads);
+}
+
+void fibheap_i64_update_key(fibheap_i64 *h, fibheap_node *x, int64_t key)
+{
+  i64_heap::update_key(h->heap, x, key);
+}
+
+void fibheap_i64_remove(fibheap_i64 *h, fibheap_node *x)
+{
+  i64_heap::remove(h->heap, x);
+}
+
+/* double keys */
+
+fibheap_f64* fibheap_f64_create(void)
+{
+  return new (std::nothrow) fibheap_f64();
+}
+
+void fibheap_f64_destroy(fibheap_f64 *h)
+{
+  delete h;
+}
+
+size_t fibheap_f64_size(const fibheap_f64 *h)
+{
+  return static_cast<size_t>(h->heap.n);
+}
+
+fibheap_node* fibheap_f64_push(fibheap_f64 *h, double key, uintptr_t payload)
+{
+  return f64_heap::push(h->heap, key, payload);
+}
+
+size_t fibheap_f64_push_n(fibheap_f64 *h, const double *keys, const uintptr_t *payloads,
+			  size_t count, fibheap_node **nodes_out)
+{
+  return f64_heap::push_n(h->heap, keys, payloads, count, nodes_out);
+}
+
+int fibheap_f64_top(const fibheap_f64 *h, double *key, uintptr_t *payload)
+{
+  return f64_heap::top(h->heap, key, payload);
+}
+
+int fibheap_f64_pop(fibheap_f64 *h, double *key, uintptr_t *payload)
+{
+  return f64_heap::pop(h->heap, key, payload);
+}
+
+size_t fibheap_f64_pop_n(fibheap_f64 *h, size_t k, double *keys, uintptr_t *payloads)
+{
+  return f64_heap::pop_n(h->heap, k, keys, payloads);
+}
+
+void fibheap_f64_update_key(fibheap_f64 *h, fibheap_node *x, double key)
+{
+  f64_heap::update_key(h->heap, x, key);
+}
+
+void fibheap_f64_remove(fibheap_f64 *h, fibheap_node *x)
+{
+  f64_heap::remove(h->heap, x);
+}
+
+/* byte string keys */
+
+fibheap_bytes* fibheap_bytes_create(void)
+{
+  return new (std::nothrow) fibheap_bytes();
+}
+
+void fibheap_bytes_destroy(fibheap_bytes *h)
+{
+  delete h;
+}
+
+size_t fibheap_bytes_size(const fibheap_bytes *h)
+{
+  return static_cast<size_t>(h->heap.n);
+}
+
+fibheap_node* fibheap_bytes_push(fibheap_bytes *h, const void *key, size_t len, uintptr_t payload)
+{
+  try
+    {
+      return bytes_heap::push(h->heap, to_bytes(key, len), payload);
+    }
+  catch (const std::bad_alloc&)
+    {
+      return nullptr;
+    }
+}
+
+size_t fibheap_bytes_push_n(fibheap_bytes *h, const void *const *keys, const size_t *lens,
+			    const uintptr_t *payloads, size_t count, fibheap_node **nodes_out)
+{
+  for (size_t i = 0; i < count; i++)
+    {
+      fibheap_node *x = fibheap_bytes_push(h, keys[i], lens[i], payloads ? payloads[i] : 0);
+      if (!x)
+	return i;
+      if (nodes_out)
+	nodes_out[i] = x;
+    }
+  return count;
+}
+
+int fibheap_bytes_top(const fibheap_bytes *h, const void **key, size_t *len, uintptr_t *payload)
+{
+  if (h->heap.empty())
+    return 0;
+  const std::string &k = h->heap.min->key;
+  if (key)
+    *key = k.data();
+  if (len)
+    *len = k.size();
+  if (payload)
+    *payload = bytes_heap::from_payload(h->heap.min->payload);
+  return 1;
+}
+
+int fibheap_bytes_pop(fibheap_bytes *h, void *buf, size_t cap, size_t *len, uintptr_t *payload)
+{
+  if (h->heap.empty())
+    return 0;
+  const std::string &k = h->heap.min->key;
+  if (len)
+    *len = k.size();
+  if (k.size() > cap)
+    return 0;
+  if (!k.empty())
+    std::memcpy(buf, k.data(), k.size());
+  return bytes_heap::pop(h->heap, nullptr, payload);
+}
+
+size_t fibheap_bytes_pop_n(fibheap_bytes *h, size_t k, void *buf, size_t cap,
+			   size_t *lens, uintptr_t *payloads)
+{
+  std::vector<bytes_heap::Node*> nodes;
+  try
+    {
+      // the keys that fit are found first, then extracted in one batch.
+      nodes = h->heap.peek_n(k);
+      size_t fit = 0, used = 0;
+      for (; fit < nodes.size() && used + nodes[fit]->key.size() <= cap; fit++)
+	used += nodes[fit]->key.size();
+      if (fit < nodes.size())
+	lens[fit] = nodes[fit]->key.size();
+      nodes = h->heap.extract_n(fit);
+    }
+  catch (const std::bad_alloc&)
+    {
+      return 0;
+    }
+  char *out = static_cast<char*>(buf);
+  for (size_t i = 0; i < nodes.size(); i++)
+    {
+      const std::string &key = nodes[i]->key;
+      lens[i] = key.size();
+      if (!key.empty())
+	std::memcpy(out, key.data(), key.size());
+      out += key.size();
+      if (payloads)
+	payloads[i] = bytes_heap::from_payload(nodes[i]->payload);
+      h->heap.destroy_node(nodes[i]);
+    }
+  return nodes.size();
+}
+
+int fibheap_bytes_update_key(fibheap_bytes *h, fibheap_node *x, const void *key, size_t len)
+{
+  try
+    {
+      bytes_heap::update_key(h->heap, x, to_bytes(key, len));
+    }
+  catch (const std::bad_alloc&)
+    {
+      return 0;
+    }
+  return 1;
+}
+
+void fibheap_bytes_remove(fibheap_bytes *h, fibheap_node *x)
+{
+  bytes_heap::remove(h->heap, x);
+}
+
+}
@@ -0,0 +1,110 @@
+/**
+ * Fibonacci Heap C API
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Stable C ABI of libfiboheap, for C and FFI users (Rust, Python, ...).
+ *
+ * Heaps and nodes are opaque handles. There is one family of functions per key
+ * type: int64 (fibheap_i64_*), double (fibheap_f64_*) and byte strings compared
+ * lexicographically (fibheap_bytes_*). Payloads are integer ids. The *_n entry
+ * points work on arrays so that FFI overhead is paid per batch.
+ *
+ * Node handles stay valid until their element is popped or removed.
+ * Functions returning int return 1 on success and 0 when the heap is empty
+ * or, for allocations, when memory is exhausted.
+ */
+
+#ifndef FIBOHEAP_C_H
+#define FIBOHEAP_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define FIBHEAP_API __declspec(dllexport)
+#else
+#define FIBHEAP_API __attribute__((visibility("default")))
+#endif
+
+#define FIBHEAP_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fibheap_i64 fibheap_i64;
+typedef struct fibheap_f64 fibheap_f64;
+typedef struct fibheap_bytes fibheap_bytes;
+typedef struct fibheap_node fibheap_node;
+
+FIBHEAP_API int fibheap_abi_version(void);
+
+/* int64 keys */
+FIBHEAP_API fibheap_i64* fibheap_i64_create(void);
+FIBHEAP_API void fibheap_i64_destroy(fibheap_i64 *h);
+FIBHEAP_API size_t fibheap_i64_size(const fibheap_i64 *h);
+FIBHEAP_API fibheap_node* fibheap_i64_push(fibheap_i64 *h, int64_t key, uintptr_t payload);
+/* payloads and nodes_out may be NULL; returns the number of elements pushed. */
+FIBHEAP_API size_t fibheap_i64_push_n(fibheap_i64 *h, const int64_t *keys, const uintptr_t *payloads,
+				      size_t count, fibheap_node **nodes_out);
+FIBHEAP_API int fibheap_i64_top(const fibheap_i64 *h, int64_t *key, uintptr_t *payload);
+FIBHEAP_API int fibheap_i64_pop(fibheap_i64 *h, int64_t *key, uintptr_t *payload);
+/* pops up to k elements in order, payloads may be NULL; returns the number popped. */
+FIBHEAP_API size_t fibheap_i64_pop_n(fibheap_i64 *h, size_t k, int64_t *keys, uintptr_t *payloads);
+FIBHEAP_API void fibheap_i64_update_key(fibheap_i64 *h, fibheap_node *x, int64_t key);
+FIBHEAP_API void fibheap_i64_remove(fibheap_i64 *h, fibheap_node *x);
+
+/* double keys */
+FIBHEAP_API fibheap_f64* fibheap_f64_create(void);
+FIBHEAP_API void fibheap_f64_destroy(fibheap_f64 *h);
+FIBHEAP_API size_t fibheap_f64_size(const fibheap_f64 *h);
+FIBHEAP_API fibheap_node* fibheap_f64_push(fibheap_f64 *h, double key, uintptr_t payload);
+FIBHEAP_API size_t fibheap_f64_push_n(fibheap_f64 *h, const double *keys, const uintptr_t *payloads,
+				      size_t count, fibheap_node **nodes_out);
+FIBHEAP_API int fibheap_f64_top(const fibheap_f64 *h, double *key, uintptr_t *payload);
+FIBHEAP_API int fibheap_f64_pop(fibheap_f64 *h, double *key, uintptr_t *payload);
+FIBHEAP_API size_t fibheap_f64_pop_n(fibheap_f64 *h, size_t k, double *keys, uintptr_t *payloads);
+FIBHEAP_API void fibheap_f64_update_key(fibheap_f64 *h, fibheap_node *x, double key);
+FIBHEAP_API void fibheap_f64_remove(fibheap_f64 *h, fibheap_node *x);
+
+/* byte string keys */
+FIBHEAP_API fibheap_bytes* fibheap_bytes_create(void);
+FIBHEAP_API void fibheap_bytes_destroy(fibheap_bytes *h);
+FIBHEAP_API size_t fibheap_bytes_size(const fibheap_bytes *h);
+FIBHEAP_API fibheap_node* fibheap_bytes_push(fibheap_bytes *h, const void *key, size_t len, uintptr_t payload);
+FIBHEAP_API size_t fibheap_bytes_push_n(fibheap_bytes *h, const void *const *keys, const size_t *lens,
+					const uintptr_t *payloads, size_t count, fibheap_node **nodes_out);
+/* *key points into the heap and stays valid until the next modification. */
+FIBHEAP_API int fibheap_bytes_top(const fibheap_bytes *h, const void **key, size_t *len, uintptr_t *payload);
+/* copies the key into buf; when it is larger than cap, nothing is popped and
+   *len is set to the required size. */
+FIBHEAP_API int fibheap_bytes_pop(fibheap_bytes *h, void *buf, size_t cap, size_t *len, uintptr_t *payload);
+/* packs up to k keys back to back into buf, stopping when the next one does not
+   fit. lens holds k entries: when fit keys are popped and the next one is left
+   in the heap because it does not fit, lens[fit] is set to its size. */
+FIBHEAP_API size_t fibheap_bytes_pop_n(fibheap_bytes *h, size_t k, void *buf, size_t cap,
+				       size_t *lens, uintptr_t *payloads);
+/* the key is copied; returns 0, with the old key left in place, when that fails. */
+FIBHEAP_API int fibheap_bytes_update_key(fibheap_bytes *h, fibheap_node *x, const void *key, size_t len);
+FIBHEAP_API void fibheap_bytes_remove(fibheap_bytes *h, fibheap_node *x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
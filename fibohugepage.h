@@ -0,0 +1,398 @@
+/**
+ * Fibonacci Heap huge page node storage
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Allocator carving heap nodes out of 2 MiB slabs, so that a heap of 1e8
+ * nodes spans a few ten thousand huge pages instead of millions of 4 KiB pages
+ * and its pointer walks stop missing the TLB. On Linux, slabs are taken from
+ * the hugetlbfs pool with MAP_HUGETLB when asked for and available, or else
+ * from transparent huge pages with madvise(MADV_HUGEPAGE); elsewhere, or when
+ * both are refused, they are plain pages and only the packing remains.
+ *
+ *   FibHeap<long, std::less<long>, false, void*, FibHugePageAllocator<long>> h;
+ *   FibHugePageHeap<long> h2; // same
+ *
+ * Each default-constructed allocator owns a fresh arena shared by its copies,
+ * freed slots are reused, and slabs go back to the system with the last copy.
+ * Slabs are committed one after the other in 1 GiB reservations of address
+ * space, so copying a heap of trivially copyable nodes is a memcpy of the
+ * used range and a rebase of the links by a constant offset.
+ */
+
+#ifndef FIBOHUGEPAGE_H
+#define FIBOHUGEPAGE_H
+
+#include "fiboheap.h"
+#include "fiboqueue.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+class fib_hugepage_arena
+{
+ public:
+  static const std::size_t slab_size = std::size_t(2) << 20;
+
+  /*
+   * slabs are committed in order inside regions of reserved address space,
+   * region_size bytes each, so that the nodes of a heap are contiguous.
+   */
+  fib_hugepage_arena(bool hugetlb = false, std::size_t region_size = std::size_t(1) << 30)
+    :want_hugetlb(hugetlb),got_hugetlb(false),region_size((region_size + slab_size - 1) / slab_size * slab_size),cur(nullptr),end(nullptr),slot_bytes(0)
+  {
+  }
+
+  ~fib_hugepage_arena()
+    {
+      for (const region &r : regions)
+	::munmap(r.base, r.reserved);
+    }
+
+  fib_hugepage_arena(const fib_hugepage_arena&) = delete;
+  fib_hugepage_arena& operator=(const fib_hugepage_arena&) = delete;
+
+  void* allocate(std::size_t bytes)
+  {
+    bytes = round(bytes);
+    if (bytes > slab_size / 8)
+      return ::operator new(bytes);
+    std::size_t c = bytes / align;
+    if (c < free_lists.size() && free_lists[c])
+      {
+	void *p = free_lists[c];
+	free_lists[c] = *static_cast<void**>(p);
+	return p;
+      }
+    // objects of a size multiple of 2^k are aligned on 2^k, up to max_align_t.
+    std::size_t a = bytes & (~bytes + 1);
+    if (a > alignof(std::max_align_t))
+      a = alignof(std::max_align_t);
+    cur = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cur) + a - 1) & ~(uintptr_t(a) - 1));
+    if (cur > end || static_cast<std::size_t>(end - cur) < bytes)
+      new_slab();
+    if (slot_bytes != bytes)
+      slot_bytes = slot_bytes == 0 ? bytes : mixed;
+    void *p = cur;
+    cur += bytes;
+    return p;
+  }
+
+  void deallocate(void *p, std::size_t bytes)
+  {
+    bytes = round(bytes);
+    if (bytes > slab_size / 8)
+      {
+	::operator delete(p);
+	return;
+      }
+    std::size_t c = bytes / align;
+    if (c >= free_lists.size())
+      free_lists.resize(c + 1, nullptr);
+    *static_cast<void**>(p) = free_lists[c];
+    free_lists[c] = p;
+  }
+
+  /*
+   * whether slabs came from the hugetlbfs pool rather than transparent huge pages.
+   */
+  bool hugetlb() const
+  {
+    return got_hugetlb;
+  }
+
+  std::size_t slab_count() const
+  {
+    std::size_t c = 0;
+    for (const region &r : regions)
+      c += r.committed / slab_size;
+    return c;
+  }
+
+  /*
+   * maps addresses in the regions of an arena to the same offsets in the
+   * regions of its clone.
+   */
+  struct rebase_map
+  {
+    /*
+     * calls f on every slot of the copy when all were carved with the given
+     * size, as with the nodes of a single heap; false when sizes were mixed.
+     */
+    template<class F>
+    bool for_each_slot(std::size_t bytes, F f) const
+    {
+      if (slot_bytes != bytes)
+	return false;
+      for (std::size_t i = 0; i < to.size(); i++)
+	for (std::size_t off = 0; off < used[i]; off += slab_size)
+	  {
+	    std::size_t count = (used[i] - off < slab_size ? used[i] - off : slab_size) / bytes;
+	    char *s = to[i] + off;
+	    for (std::size_t k = 0; k < count; k++)
+	      f(s + k * bytes);
+	  }
+      return true;
+    }
+
+    void* operator()(const void *p) const
+    {
+      if (!p)
+	return nullptr;
+      const char *c = static_cast<const char*>(p);
+      for (std::size_t i = 0; i < from.size(); i++)
+	if (c >= from[i] && c < from[i] + size[i])
+	  return to[i] + (c - from[i]);
+      return nullptr;
+    }
+
+    std::vector<const char*> from;
+    std::vector<char*> to;
+    std::vector<std::size_t> size;
+    std::vector<std::size_t> used;
+    std::size_t slot_bytes;
+  };
+
+  /*
+   * a new arena holding a byte copy of the used part of every region, and the
+   * free lists carried over; rebase is filled to map pointers into the copy.
+   */
+  std::shared_ptr<fib_hugepage_arena> clone(rebase_map &rebase) const
+  {
+    std::shared_ptr<fib_hugepage_arena> c = std::make_shared<fib_hugepage_arena>(got_hugetlb, region_size);
+    for (const region &r : regions)
+      {
+	c->reserve(r.reserved);
+	while (c->regions.back().committed < r.committed)
+	  c->commit_slab();
+	region &d = c->regions.back();
+	// the last region is only used up to cur.
+	std::size_t used = cur >= r.base && cur <= r.base + r.committed ? static_cast<std::size_t>(cur - r.base) : r.committed;
+	std::memcpy(d.base, r.base, used);
+	rebase.from.push_back(r.base);
+	rebase.to.push_back(d.base);
+	rebase.size.push_back(r.reserved);
+	rebase.used.push_back(used);
+      }
+    rebase.slot_bytes = slot_bytes;
+    c->slot_bytes = slot_bytes;
+    // an arena that never carved a slot has no current slab to map.
+    if (end == nullptr)
+      c->cur = c->end = nullptr;
+    else
+      {
+	c->cur = static_cast<char*>(rebase(cur));
+	c->end = static_cast<char*>(rebase(end - 1)) + 1;
+      }
+    c->free_lists.assign(free_lists.size(), nullptr);
+    for (std::size_t i = 0; i < free_lists.size(); i++)
+      {
+	void **tail = &c->free_lists[i];
+	for (void *p = free_lists[i]; p; p = *static_cast<void**>(p))
+	  {
+	    *tail = rebase(p);
+	    tail = static_cast<void**>(*tail);
+	  }
+	*tail = nullptr;
+      }
+    return c;
+  }
+
+ private:
+  struct region
+  {
+    char *base;
+    std::size_t reserved;
+    std::size_t committed;
+  };
+
+  // the free lists are threaded through the slots themselves.
+  static const std::size_t align = sizeof(void*);
+  static const std::size_t mixed = ~std::size_t(0);
+
+  static std::size_t round(std::size_t bytes)
+  {
+    return (bytes + align - 1) / align * align;
+  }
+
+  void new_slab()
+  {
+    if (regions.empty() || regions.back().committed == regions.back().reserved)
+      reserve(region_size);
+    commit_slab();
+    const region &r = regions.back();
+    cur = r.base + r.committed - slab_size;
+    end = cur + slab_size;
+  }
+
+  /*
+   * reserves address space only, aligned on 2 MiB as huge pages need.
+   */
+  void reserve(std::size_t bytes)
+  {
+    void *m = ::mmap(nullptr, bytes + slab_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m == MAP_FAILED)
+      throw std::bad_alloc();
+    uintptr_t b = reinterpret_cast<uintptr_t>(m);
+    uintptr_t a = (b + slab_size - 1) & ~(uintptr_t(slab_size) - 1);
+    if (a > b)
+      ::munmap(m, a - b);
+    if (a + bytes < b + bytes + slab_size)
+      ::munmap(reinterpret_cast<void*>(a + bytes), b + slab_size - a);
+    region r = { reinterpret_cast<char*>(a), bytes, 0 };
+    regions.push_back(r);
+  }
+
+  void commit_slab()
+  {
+    region &r = regions.back();
+    char *s = r.base + r.committed;
+#if defined(__linux__) && defined(MAP_HUGETLB)
+    if (want_hugetlb)
+      {
+	void *m = ::mmap(s, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+	got_hugetlb = m != MAP_FAILED;
+	// the pool is empty or not configured, do not ask again.
+	want_hugetlb = got_hugetlb;
+	if (got_hugetlb)
+	  {
+	    r.committed += slab_size;
+	    return;
+	  }
+      }
+#endif
+    if (::mprotect(s, slab_size, PROT_READ | PROT_WRITE) != 0)
+      throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // a refusal (THP disabled) leaves ordinary pages, which is fine.
+    ::madvise(s, slab_size, MADV_HUGEPAGE);
+#endif
+    r.committed += slab_size;
+  }
+
+  bool want_hugetlb;
+  bool got_hugetlb;
+  std::size_t region_size;
+  char *cur;
+  char *end;
+  std::size_t slot_bytes; // size of every bump allocation so far, or mixed.
+  std::vector<region> regions;
+  std::vector<void*> free_lists; // by size in units of align.
+};
+
+template<class T>
+class FibHugePageAllocator
+{
+ public:
+  typedef T value_type;
+
+  explicit FibHugePageAllocator(bool hugetlb = false)
+    :arena(std::make_shared<fib_hugepage_arena>(hugetlb))
+  {
+  }
+
+  explicit FibHugePageAllocator(std::shared_ptr<fib_hugepage_arena> a)
+    :arena(std::move(a))
+  {
+  }
+
+  template<class U>
+  FibHugePageAllocator(const FibHugePageAllocator<U> &o)
+    :arena(o.arena)
+  {
+  }
+
+  /*
+   * a copied heap gets an arena of its own.
+   */
+  FibHugePageAllocator select_on_container_copy_construction() const
+  {
+    return FibHugePageAllocator(arena->hugetlb());
+  }
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(arena->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n)
+  {
+    arena->deallocate(p, n * sizeof(T));
+  }
+
+  template<class U>
+  bool operator==(const FibHugePageAllocator<U> &o) const
+  {
+    return arena == o.arena;
+  }
+
+  template<class U>
+  bool operator!=(const FibHugePageAllocator<U> &o) const
+  {
+    return arena != o.arena;
+  }
+
+  std::shared_ptr<fib_hugepage_arena> arena;
+};
+
+/*
+ * copying a heap of trivially copyable nodes copies the slabs with memcpy.
+ */
+template<class T>
+struct fib_block_clone<FibHugePageAllocator<T> >
+{
+  static const bool enabled = true;
+
+  struct rebase
+  {
+    T* operator()(T *p) const
+    {
+      return static_cast<T*>(map(p));
+    }
+
+    /*
+     * calls f on every node copy, in memory order when the slabs hold nodes only.
+     */
+    template<class F, class Walk>
+    void for_each_copy(F f, Walk walk) const
+    {
+      if (!map.for_each_slot(sizeof(T), [&f](char *s) { f(reinterpret_cast<T*>(s)); }))
+	walk([this, &f](T *x) { f((*this)(x)); });
+    }
+
+    fib_hugepage_arena::rebase_map map;
+  };
+
+  static rebase clone(const FibHugePageAllocator<T> &from, FibHugePageAllocator<T> &to)
+  {
+    rebase r;
+    to = FibHugePageAllocator<T>(from.arena->clone(r.map));
+    return r;
+  }
+};
+
+template<class T, class Comp = std::less<T>>
+using FibHugePageHeap = FibHeap<T, Comp, false, void*, FibHugePageAllocator<T>>;
+
+template<class T, class Comp = std::less<T>>
+using FibHugePageQueue = FibQueue<T, Comp, false, void*, FibHugePageAllocator<T>>;
+
+#endif
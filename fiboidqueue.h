@@ -0,0 +1,365 @@
+/**
+ * Fibonacci Queue with identity handles
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Priority queue addressed by a user identity (job id, UUID, ...) instead of
+ * by priority. Each node stores its id as its typed payload, and a flat Robin
+ * Hood table maps ids to nodes: slots hold the node pointer and a hash
+ * fragment only, so the table never allocates per element and lookups compare
+ * ids only on fragment hits. Key changes do not touch the table at all, pop
+ * and remove erase one slot with backward shifting.
+ */
+
+#ifndef FIBOIDQUEUE_H
+#define FIBOIDQUEUE_H
+
+#include "fiboheap.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+/*
+ * open-addressing map from Node::payload to Node*, with Robin Hood insertion.
+ */
+template<class Node, class Id, class Hash = std::hash<Id>, class Eq = std::equal_to<Id>>
+class fib_id_map
+{
+ public:
+  fib_id_map(Hash hash = Hash(), Eq eq = Eq())
+    :mask(0),count(0),hash(hash),eq(eq)
+  {
+  }
+
+  fib_id_map(fib_id_map &&o) noexcept
+    :slots(std::move(o.slots)),mask(o.mask),count(o.count),hash(o.hash),eq(o.eq)
+  {
+    o.slots.clear();
+    o.mask = 0;
+    o.count = 0;
+  }
+
+  fib_id_map& operator=(fib_id_map &&o) noexcept
+  {
+    slots = std::move(o.slots);
+    mask = o.mask;
+    count = o.count;
+    hash = o.hash;
+    eq = o.eq;
+    o.slots.clear();
+    o.mask = 0;
+    o.count = 0;
+    return *this;
+  }
+
+  // the slots point to the nodes of one queue.
+  fib_id_map(const fib_id_map&) = delete;
+  fib_id_map& operator=(const fib_id_map&) = delete;
+
+  Node* find(const Id &id) const
+  {
+    if (slots.empty())
+      return nullptr;
+    uint32_t frag = fragment(id);
+    std::size_t i = frag & mask;
+    for (uint32_t d = 1;; d++)
+      {
+	const slot &s = slots[i];
+	// past the probe distance the id would have taken its place.
+	if (s.dist < d)
+	  return nullptr;
+	if (s.frag == frag && eq(s.node->payload, id))
+	  return s.node;
+	i = (i + 1) & mask;
+      }
+  }
+
+  /*
+   * x->payload must not be in the map yet.
+   */
+  void insert(Node *x)
+  {
+    if ((count + 1) * 8 > slots.size() * 7)
+      grow();
+    place(slot { x, fragment(x->payload), 1 });
+    count++;
+  }
+
+  bool erase(const Id &id)
+  {
+    if (slots.empty())
+      return false;
+    uint32_t frag = fragment(id);
+    std::size_t i = frag & mask;
+    for (uint32_t d = 1;; d++)
+      {
+	if (slots[i].dist < d)
+	  return false;
+	if (slots[i].frag == frag && eq(slots[i].node->payload, id))
+	  break;
+	i = (i + 1) & mask;
+      }
+    // shift the following run back by one, so no tombstone is left.
+    std::size_t j = (i + 1) & mask;
+    while (slots[j].dist > 1)
+      {
+	slots[i] = slots[j];
+	slots[i].dist--;
+	i = j;
+	j = (j + 1) & mask;
+      }
+    slots[i] = slot();
+    count--;
+    return true;
+  }
+
+  void reserve(std::size_t n)
+  {
+    while (n * 8 > slots.size() * 7)
+      grow();
+  }
+
+  void clear()
+  {
+    slots.assign(slots.size(), slot());
+    count = 0;
+  }
+
+  std::size_t size() const
+  {
+    return count;
+  }
+
+  Hash hasher() const
+  {
+    return hash;
+  }
+
+  Eq key_eq() const
+  {
+    return eq;
+  }
+
+ private:
+  struct slot
+  {
+    Node *node;
+    uint32_t frag;
+    uint32_t dist; // probe distance + 1, 0 when empty.
+  };
+
+  uint32_t fragment(const Id &id) const
+  {
+    // Fibonacci hashing, so that identity hashes of integers spread too.
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash(id)) * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+  }
+
+  void place(slot cur)
+  {
+    std::size_t i = cur.frag & mask;
+    for (;;)
+      {
+	if (slots[i].dist == 0)
+	  {
+	    slots[i] = cur;
+	    return;
+	  }
+	// take from the rich: the element closer to its home slot moves on.
+	if (slots[i].dist < cur.dist)
+	  std::swap(slots[i], cur);
+	i = (i + 1) & mask;
+	cur.dist++;
+      }
+  }
+
+  void grow()
+  {
+    std::vector<slot> old(slots.size() ? slots.size() * 2 : 16, slot());
+    old.swap(slots);
+    mask = slots.size() - 1;
+    for (const slot &s : old)
+      if (s.dist)
+	place(slot { s.node, s.frag, 1 });
+  }
+
+  std::vector<slot> slots;
+  std::size_t mask;
+  std::size_t count;
+  Hash hash;
+  Eq eq;
+};
+
+/*
+ * handle policy of FibIdQueue: the id map, which only changes when nodes come
+ * and go since key changes leave the ids alone.
+ */
+template<class Node, class Id, class Hash = std::hash<Id>, class Eq = std::equal_to<Id>>
+class fib_id_handles
+{
+ public:
+  static const bool enabled = true;
+
+  fib_id_handles(Hash hash = Hash(), Eq eq = Eq())
+    :ids(hash, eq)
+  {
+  }
+
+  // the map points to the nodes of one heap, a copy indexes its own.
+  fib_id_handles(const fib_id_handles &o)
+    :ids(o.ids.hasher(), o.ids.key_eq())
+  {
+  }
+
+  fib_id_handles(fib_id_handles&&) = default;
+  fib_id_handles& operator=(fib_id_handles&&) = default;
+
+  /*
+   * x->payload must not be queued yet.
+   */
+  void handle_insert(Node *x)
+  {
+    ids.insert(x);
+  }
+
+  void handle_erase(Node *x)
+  {
+    ids.erase(x->payload);
+  }
+
+  void handle_rekey_begin(Node*)
+  {
+  }
+
+  void handle_rekey_end(Node*)
+  {
+  }
+
+  void handle_clear()
+  {
+    ids.clear();
+  }
+
+  void handle_reserve(std::size_t n)
+  {
+    ids.reserve(n);
+  }
+
+  fib_id_map<Node, Id, Hash, Eq> ids;
+};
+
+template<class Id, class T, class Comp = std::less<T>, class Hash = std::hash<Id>, class Eq = std::equal_to<Id>>
+class FibIdQueue : public FibHeap<T, Comp, false, Id, std::allocator<T>, fib_no_stats, fib_no_parallel,
+				  fib_id_handles<fib_node<T, Id>, Id, Hash, Eq> >
+{
+ public:
+  using Handles = fib_id_handles<fib_node<T, Id>, Id, Hash, Eq>;
+  using Heap = FibHeap<T, Comp, false, Id, std::allocator<T>, fib_no_stats, fib_no_parallel, Handles>;
+  using Node = typename Heap::FibNode;
+
+  FibIdQueue()
+    : Heap()
+  {
+  }
+
+  FibIdQueue(Comp comp, Hash hash = Hash(), Eq eq = Eq())
+    : Heap(comp, std::allocator<T>(), Handles(hash, eq))
+  {
+  }
+
+  // the heap copies index their own nodes.
+  FibIdQueue(const FibIdQueue&) = default;
+  FibIdQueue(FibIdQueue&&) = default;
+  FibIdQueue& operator=(const FibIdQueue&) = default;
+  FibIdQueue& operator=(FibIdQueue&&) = default;
+
+  FibIdQueue clone() const
+  {
+    return FibIdQueue(*this);
+  }
+
+  ~FibIdQueue()
+    {
+    }
+
+  /*
+   * returns nullptr if id is already queued.
+   */
+  Node* push(const Id &id, T k)
+  {
+    if (Heap::ids.find(id))
+      {
+	std::cerr << "[Error]: id already in FibIdQueue\n";
+	return nullptr;
+      }
+    return Heap::emplace(std::move(k),id);
+  }
+
+  Node* find(const Id &id) const
+  {
+    return Heap::ids.find(id);
+  }
+
+  bool contains(const Id &id) const
+  {
+    return Heap::ids.find(id) != nullptr;
+  }
+
+  const Id& top_id()
+  {
+    return Heap::minimum()->payload;
+  }
+
+  using Heap::decrease_key;
+  using Heap::update_key;
+
+  bool decrease_key(const Id &id, T k)
+  {
+    Node *x = Heap::ids.find(id);
+    if (!x)
+      return false;
+    Heap::decrease_key(x,std::move(k));
+    return true;
+  }
+
+  bool update_key(const Id &id, T k)
+  {
+    Node *x = Heap::ids.find(id);
+    if (!x)
+      return false;
+    Heap::update_key(x,std::move(k));
+    return true;
+  }
+
+  bool remove(const Id &id)
+  {
+    Node *x = Heap::ids.find(id);
+    if (!x)
+      return false;
+    Heap::remove_fibnode(x);
+    return true;
+  }
+
+  void reserve(std::size_t n)
+  {
+    Heap::ids.reserve(n);
+  }
+};
+
+#endif
@@ -0,0 +1,290 @@
+/**
+ * Fibonacci Heap k-way merge
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Streaming merge of sorted runs. The heap is keyed by the run cursors, so
+ * elements are never copied, and each run owns one node allocated up front
+ * that is advanced with replace_top(): the merge is allocation-free once started.
+ * A merge moves with its nodes, so kway_merge() can return it by value.
+ *
+ *   for (const auto &v : kway_merge(runs)) ...
+ *
+ * where runs is a vector of (begin, end) iterator pairs, e.g. from FibMappedRun
+ * for files of trivially copyable records.
+ */
+
+#ifndef FIBOMERGE_H
+#define FIBOMERGE_H
+
+#include "fiboheap.h"
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template<class Iter, class Comp = std::less<typename std::iterator_traits<Iter>::value_type>>
+class FibMerge
+{
+ public:
+  using value_type = typename std::iterator_traits<Iter>::value_type;
+
+  struct cursor
+  {
+    Iter it;
+    Iter end;
+  };
+
+  struct cursor_less
+  {
+    bool operator()(const cursor &x, const cursor &y) const
+    {
+      return comp(*x.it, *y.it);
+    }
+
+    Comp comp;
+  };
+
+  using Heap = FibHeap<cursor, cursor_less, false, void>;
+  using Node = typename Heap::FibNode;
+
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = typename FibMerge::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    iterator(FibMerge *m)
+      :m(m)
+    {
+    }
+
+    reference operator*() const
+    {
+      return m->top();
+    }
+
+    pointer operator->() const
+    {
+      return &m->top();
+    }
+
+    iterator& operator++()
+    {
+      m->pop();
+      return *this;
+    }
+
+    void operator++(int)
+    {
+      m->pop();
+    }
+
+    bool operator==(const iterator &o) const
+    {
+      return done() == o.done();
+    }
+
+    bool operator!=(const iterator &o) const
+    {
+      return !(*this == o);
+    }
+
+  private:
+    bool done() const
+    {
+      return m == nullptr || m->empty();
+    }
+
+    FibMerge *m;
+  };
+
+  template<class Runs>
+  FibMerge(const Runs &runs, Comp comp = Comp())
+    :heap(cursor_less { comp })
+  {
+    nodes.reserve(runs.size());
+    for (const auto &r : runs)
+      {
+	if (r.first == r.second)
+	  continue;
+	nodes.emplace_back(cursor { r.first, r.second });
+	heap.insert(&nodes.back());
+      }
+  }
+
+  ~FibMerge()
+    {
+      // nodes belong to this merge, not to the heap.
+      heap.min = nullptr;
+      heap.n = 0;
+    }
+
+  FibMerge(const FibMerge&) = delete;
+  FibMerge& operator=(const FibMerge&) = delete;
+
+  // the node buffer moves along, so the heap links stay valid.
+  FibMerge(FibMerge &&o) noexcept
+    :heap(std::move(o.heap)),nodes(std::move(o.nodes))
+  {
+  }
+
+  FibMerge& operator=(FibMerge &&o) noexcept
+  {
+    if (this != &o)
+      {
+	heap.min = nullptr;
+	heap.n = 0;
+	heap = std::move(o.heap);
+	nodes = std::move(o.nodes);
+      }
+    return *this;
+  }
+
+  bool empty() const
+  {
+    return heap.empty();
+  }
+
+  const value_type& top() const
+  {
+    return *heap.min->key.it;
+  }
+
+  /*
+   * advances the run holding the top element, and drops it once exhausted.
+   */
+  void pop()
+  {
+    cursor c = heap.min->key;
+    if (++c.it == c.end)
+      heap.extract_min();
+    else
+      heap.replace_top(c);
+  }
+
+  iterator begin()
+  {
+    return iterator(this);
+  }
+
+  iterator end()
+  {
+    return iterator(nullptr);
+  }
+
+ private:
+  Heap heap;
+  std::vector<Node> nodes;
+};
+
+template<class Runs>
+FibMerge<typename Runs::value_type::first_type> kway_merge(const Runs &runs)
+{
+  return FibMerge<typename Runs::value_type::first_type>(runs);
+}
+
+template<class Runs, class Comp>
+FibMerge<typename Runs::value_type::first_type, Comp> kway_merge(const Runs &runs, Comp comp)
+{
+  return FibMerge<typename Runs::value_type::first_type, Comp>(runs, comp);
+}
+
+/*
+ * read-only mapping of a file of sorted, trivially copyable records,
+ * usable as a run: { run.begin(), run.end() }.
+ */
+template<class T>
+class FibMappedRun
+{
+ public:
+  FibMappedRun(const std::string &path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+      {
+	if (fd >= 0)
+	  ::close(fd);
+	std::cerr << "[Error]: cannot open run " << path << std::endl;
+	return;
+      }
+    size = static_cast<std::size_t>(st.st_size) / sizeof(T) * sizeof(T);
+    if (size > 0)
+      {
+	void *m = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (m == MAP_FAILED)
+	  {
+	    std::cerr << "[Error]: cannot map run " << path << std::endl;
+	    size = 0;
+	  }
+	else
+	  {
+	    map = m;
+	    ::madvise(map, size, MADV_SEQUENTIAL);
+	  }
+      }
+    ::close(fd);
+  }
+
+  FibMappedRun(FibMappedRun &&o) noexcept
+    :map(o.map),size(o.size)
+  {
+    o.map = nullptr;
+    o.size = 0;
+  }
+
+  FibMappedRun(const FibMappedRun&) = delete;
+  FibMappedRun& operator=(const FibMappedRun&) = delete;
+
+  ~FibMappedRun()
+    {
+      if (map)
+	::munmap(map, size);
+    }
+
+  const T* begin() const
+  {
+    return static_cast<const T*>(map);
+  }
+
+  const T* end() const
+  {
+    return begin() + size / sizeof(T);
+  }
+
+  std::pair<const T*, const T*> range() const
+  {
+    return { begin(), end() };
+  }
+
+ private:
+  void *map = nullptr;
+  std::size_t size = 0;
+};
+
+#endif
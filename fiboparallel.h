@@ -0,0 +1,157 @@
+/**
+ * Fibonacci Heap parallel consolidation
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Parallel policy of FibHeap: after a bulk load, consolidate() links a root
+ * list of at least FIBOHEAP_PARALLEL_THRESHOLD roots on several threads, each
+ * with its own degree table.
+ *
+ *   FibParallelHeap<long> h; // or any FibHeap with fib_parallel_consolidate
+ *   h.set_parallel_consolidate(1 << 16, 8, pool_executor);
+ *
+ * Heaps with the default fib_no_parallel policy carry none of this state.
+ */
+
+#ifndef FIBOPARALLEL_H
+#define FIBOPARALLEL_H
+
+#include "fiboheap.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*
+ * consolidate() links the roots on several threads when there are at least
+ * this many of them, as after a bulk load; see set_parallel_consolidate().
+ */
+#ifndef FIBOHEAP_PARALLEL_THRESHOLD
+#define FIBOHEAP_PARALLEL_THRESHOLD (1 << 20)
+#endif
+
+/*
+ * runs task(0) ... task(tasks - 1) concurrently and returns once all are done,
+ * the caller's thread taking task 0.
+ */
+typedef std::function<void(std::size_t, const std::function<void(std::size_t)>&)> fib_executor;
+
+inline void fib_thread_executor(std::size_t tasks, const std::function<void(std::size_t)> &task)
+{
+  std::vector<std::thread> threads;
+  threads.reserve(tasks);
+  for (std::size_t t = 1; t < tasks; t++)
+    threads.emplace_back(task, t);
+  task(0);
+  for (std::thread &th : threads)
+    th.join();
+}
+
+class fib_parallel_consolidate
+{
+ public:
+  fib_parallel_consolidate()
+    :threshold(FIBOHEAP_PARALLEL_THRESHOLD),tasks(0)
+  {
+  }
+
+  /*
+   * consolidates on tasks threads, through executor, when the root list holds
+   * at least threshold roots. tasks = 0 uses the hardware concurrency and
+   * no executor uses fresh threads, threshold = 0 turns it off.
+   * Comp must then be safe to call concurrently.
+   */
+  void set_parallel_consolidate(std::size_t threshold, std::size_t tasks = 0, fib_executor executor = fib_executor())
+  {
+    this->threshold = threshold;
+    this->tasks = tasks;
+    this->executor = std::move(executor);
+  }
+
+  /*
+   * the number of threads to consolidate that many roots on, 1 for sequential.
+   */
+  std::size_t consolidate_tasks(std::size_t roots) const
+  {
+    if ( threshold == 0 || roots < threshold )
+      return 1;
+    std::size_t t = tasks ? tasks : std::thread::hardware_concurrency();
+    // slices below a few thousand roots cost more to hand out than to link.
+    if ( t > roots / 4096 )
+      t = roots / 4096;
+    return t ? t : 1;
+  }
+
+  /*
+   * consolidate steps 4-14: links the roots from min into the degree table
+   * A of slots entries, and counts them in walked. Each task links its slice
+   * of the roots into its own table, with make_child() so that no root list
+   * pointer is shared between tasks; the tables are then carried into A in
+   * order. The root list itself is rebuilt from A by consolidate().
+   */
+  template<class Heap, class Node>
+  bool link_roots( Heap &h, Node *min, Node **A, int slots, std::size_t &walked )
+  {
+    if ( threshold == 0 )
+      return false;
+    // the roots are only gathered when it may pay, into a reused buffer.
+    roots.clear();
+    Node *w = min;
+    do
+      {
+	roots.push_back(w);
+	w = w->right;
+      } while ( w != min );
+    walked = roots.size();
+    std::size_t t = consolidate_tasks(roots.size());
+    if ( t <= 1 )
+      {
+	for ( void *x : roots )
+	  h.carry_root(A, static_cast<Node*>(x));
+	return true;
+      }
+    std::size_t slice = (roots.size() + t - 1) / t;
+    std::vector<Node*> tables(t * slots, nullptr);
+    std::function<void(std::size_t)> task = [&](std::size_t i) {
+      Node **At = &tables[i * slots];
+      std::size_t end = (i + 1) * slice < roots.size() ? (i + 1) * slice : roots.size();
+      for ( std::size_t j = i * slice; j < end; j++ )
+	h.carry_root(At, static_cast<Node*>(roots[j]));
+    };
+    if ( executor )
+      executor(t, task);
+    else
+      fib_thread_executor(t, task);
+    for ( std::size_t i = 0; i < t; i++ )
+      for ( int d = 0; d < slots; d++ )
+	if ( tables[i * slots + d] != nullptr )
+	  h.carry_root(A, tables[i * slots + d]);
+    return true;
+  }
+
+ private:
+  std::size_t threshold;
+  std::size_t tasks;
+  fib_executor executor;
+  std::vector<void*> roots; // untyped, so that the policy needs no node type.
+};
+
+template<class T, class Comp = std::less<T>, bool Stable = false>
+using FibParallelHeap = FibHeap<T, Comp, Stable, void*, std::allocator<T>, fib_no_stats, fib_parallel_consolidate>;
+
+#endif
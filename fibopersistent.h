@@ -0,0 +1,298 @@
+/**
+ * Persistent heap
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Immutable priority queue for search trees that fork their frontier, such
+ * as branch-and-bound. push, pop and merge leave the heap alone and return a
+ * new version sharing all but O(log n) nodes with it, so copying a version is
+ * O(1) and memory grows with the changes only.
+ *
+ *   FibPersistentHeap<int> h0;
+ *   FibPersistentHeap<int> h1 = h0.push(3).push(1); // h0 is still empty
+ *   FibPersistentHeap<int> h2 = h1.pop();           // h1.top() is still 1
+ *
+ * It is a leftist heap with path copying: a Fibonacci heap relies on in-place
+ * updates and amortization, which do not survive sharing. Nodes are reference
+ * counted and recycled through a pool shared by the versions of one thread,
+ * neither of which is synchronized, so a heap and all versions derived from it
+ * must stay on one thread.
+ */
+
+#ifndef FIBOPERSISTENT_H
+#define FIBOPERSISTENT_H
+
+#include "fiboheap.h"
+#include "fibopool.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+template<class T, class Comp = std::less<T>>
+class FibPersistentHeap
+{
+ public:
+  struct node
+  {
+    node(T k, node *l, node *r)
+      :key(std::move(k)),left(l),right(r),rank(1),refs(1)
+    {
+    }
+
+    T key;
+    node *left;
+    node *right;
+    uint32_t rank; // length of the right spine.
+    uint32_t refs;
+  };
+
+  typedef fib_node_pool<node> pool_type;
+
+  FibPersistentHeap()
+    :FibPersistentHeap(Comp())
+  {
+  }
+
+  /*
+   * versions made from this heap share its pool; by default, that of the thread.
+   */
+  FibPersistentHeap(Comp comp, std::shared_ptr<pool_type> pool = default_pool())
+    :pool(std::move(pool)),root(nullptr),n(0),comp(comp)
+  {
+  }
+
+  FibPersistentHeap(const FibPersistentHeap &o)
+    :pool(o.pool),root(retain(o.root)),n(o.n),comp(o.comp)
+  {
+  }
+
+  FibPersistentHeap(FibPersistentHeap &&o) noexcept
+    :pool(o.pool),root(o.root),n(o.n),comp(o.comp)
+  {
+    o.root = nullptr;
+    o.n = 0;
+  }
+
+  FibPersistentHeap& operator=(FibPersistentHeap o) noexcept
+  {
+    std::swap(pool, o.pool);
+    std::swap(root, o.root);
+    std::swap(n, o.n);
+    std::swap(comp, o.comp);
+    return *this;
+  }
+
+  ~FibPersistentHeap()
+    {
+      release(root);
+    }
+
+  bool empty() const
+  {
+    return root == nullptr;
+  }
+
+  std::size_t size() const
+  {
+    return n;
+  }
+
+  const T& top() const
+  {
+    return root->key;
+  }
+
+  /*
+   * a version with k added.
+   */
+  FibPersistentHeap push(T k) const
+  {
+    node *x = make(std::move(k), nullptr, nullptr);
+    FibPersistentHeap h(*this, merge(root, x), n + 1);
+    release(x);
+    return h;
+  }
+
+  /*
+   * a version without the top, or an empty heap.
+   */
+  FibPersistentHeap pop() const
+  {
+    if (!root)
+      return *this;
+    return FibPersistentHeap(*this, merge(root->left, root->right), n - 1);
+  }
+
+  /*
+   * a version holding the keys of both heaps. The nodes of a heap from
+   * another pool are copied into this one first, in O(m).
+   */
+  FibPersistentHeap merge(const FibPersistentHeap &o) const
+  {
+    if (o.pool == pool)
+      return FibPersistentHeap(*this, merge(root, o.root), n + o.n);
+    node *c = copy_nodes(o.root);
+    FibPersistentHeap h(*this, merge(root, c), n + o.n);
+    release(c);
+    return h;
+  }
+
+  /*
+   * the number of versions sharing the top node, for tests and diagnostics.
+   */
+  uint32_t use_count() const
+  {
+    return root ? root->refs : 0;
+  }
+
+  static std::shared_ptr<pool_type> default_pool()
+  {
+    static thread_local std::shared_ptr<pool_type> p = std::make_shared<pool_type>();
+    return p;
+  }
+
+ private:
+  // takes ownership of r.
+  FibPersistentHeap(const FibPersistentHeap &o, node *r, std::size_t size)
+    :pool(o.pool),root(r),n(size),comp(o.comp)
+  {
+  }
+
+  static node* retain(node *x)
+  {
+    if (x)
+      x->refs++;
+    return x;
+  }
+
+  /*
+   * drops a reference, freeing the nodes no version uses anymore; iterative,
+   * since the left spine of a leftist heap is not bounded.
+   */
+  void release(node *x) const
+  {
+    std::vector<node*> dead;
+    for (;;)
+      {
+	if (x && --x->refs == 0)
+	  {
+	    dead.push_back(x->left);
+	    dead.push_back(x->right);
+	    x->~node();
+	    pool->deallocate(x);
+	  }
+	if (dead.empty())
+	  return;
+	x = dead.back();
+	dead.pop_back();
+      }
+  }
+
+  /*
+   * takes ownership of l and r, and puts the higher rank on the left.
+   */
+  node* make(T k, node *l, node *r) const
+  {
+    void *p = pool->allocate();
+    node *x;
+    try
+      {
+	x = new (p) node(std::move(k), l, r);
+      }
+    catch (...)
+      {
+	pool->deallocate(p);
+	release(l);
+	release(r);
+	throw;
+      }
+    if (rank(l) < rank(r))
+      std::swap(x->left, x->right);
+    x->rank = rank(x->right) + 1;
+    return x;
+  }
+
+  static uint32_t rank(const node *x)
+  {
+    return x ? x->rank : 0;
+  }
+
+  /*
+   * merge(a,b) borrows a and b, and returns an owned root. Only the right
+   * spines are copied, on equal keys a stays above b.
+   */
+  node* merge(node *a, node *b) const
+  {
+    if (!a)
+      return retain(b);
+    if (!b)
+      return retain(a);
+    if (comp(b->key, a->key))
+      std::swap(a, b);
+    node *r = merge(a->right, b);
+    return make(a->key, retain(a->left), r);
+  }
+
+  /*
+   * an owned copy of the tree under x, allocated from this pool.
+   */
+  node* copy_nodes(const node *x) const
+  {
+    if (!x)
+      return nullptr;
+    node *c = make(x->key, nullptr, nullptr);
+    std::vector<std::pair<const node*, node*>> todo(1, std::make_pair(x, c));
+    try
+      {
+	while (!todo.empty())
+	  {
+	    const node *from = todo.back().first;
+	    node *to = todo.back().second;
+	    todo.pop_back();
+	    // each copy is linked as soon as made, so that a throw frees it with c.
+	    if (from->left)
+	      {
+		to->left = make(from->left->key, nullptr, nullptr);
+		todo.push_back(std::make_pair(from->left, to->left));
+	      }
+	    if (from->right)
+	      {
+		to->right = make(from->right->key, nullptr, nullptr);
+		todo.push_back(std::make_pair(from->right, to->right));
+	      }
+	    to->rank = from->rank;
+	  }
+      }
+    catch (...)
+      {
+	release(c);
+	throw;
+      }
+    return c;
+  }
+
+  std::shared_ptr<pool_type> pool; // outlives the nodes released in the destructor.
+  node *root;
+  std::size_t n;
+  Comp comp;
+};
+
+#endif
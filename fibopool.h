@@ -0,0 +1,95 @@
+/**
+ * Fibonacci Heap node pool
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Fixed-size slot allocator for the node-based structures built next to the
+ * heap (soft, persistent and adaptive heaps): slots are carved out of blocks
+ * of 1024 and recycled through a free list, and the blocks are only released
+ * with the pool.
+ */
+
+#ifndef FIBOPOOL_H
+#define FIBOPOOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*
+ * free list of Node slots carved out of blocks, the blocks are freed with the pool.
+ */
+template<class Node>
+class fib_node_pool
+{
+ public:
+  fib_node_pool()
+    :free_list(nullptr)
+  {
+  }
+
+  ~fib_node_pool()
+    {
+      for (void *b : blocks)
+	::operator delete(b);
+    }
+
+  fib_node_pool(const fib_node_pool&) = delete;
+  fib_node_pool& operator=(const fib_node_pool&) = delete;
+
+  void* allocate()
+  {
+    if (!free_list)
+      grow();
+    slot *s = free_list;
+    free_list = s->next;
+    return s;
+  }
+
+  void deallocate(void *p)
+  {
+    slot *s = static_cast<slot*>(p);
+    s->next = free_list;
+    free_list = s;
+  }
+
+ private:
+  union slot
+  {
+    slot *next;
+    typename std::aligned_storage<sizeof(Node), alignof(Node)>::type node;
+  };
+
+  static const std::size_t block_slots = 1024;
+
+  void grow()
+  {
+    slot *b = static_cast<slot*>(::operator new(block_slots * sizeof(slot)));
+    blocks.push_back(b);
+    for (std::size_t i = block_slots; i-- > 0;)
+      {
+	b[i].next = free_list;
+	free_list = &b[i];
+      }
+  }
+
+  slot *free_list;
+  std::vector<void*> blocks;
+};
+
+#endif
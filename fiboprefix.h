@@ -0,0 +1,195 @@
+/**
+ * Fibonacci Heap key prefixes
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Opt-in key layout for heaps with expensive comparators (strings, tuples).
+ * The key is stored together with a normalized 64-bit prefix, so that most
+ * comparisons in insert, consolidate and decrease_key are a single integer
+ * compare, and only prefix ties fall back to the full comparator.
+ */
+
+#ifndef FIBOPREFIX_H
+#define FIBOPREFIX_H
+
+#include "fiboheap.h"
+#include "fiboqueue.h"
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * key_prefix<T>::get(k) maps a key to an unsigned integer such that
+ * k1 < k2 implies get(k1) <= get(k2).
+ */
+template<class T, class Enable = void>
+struct key_prefix;
+
+template<class T>
+struct key_prefix<T, typename std::enable_if<std::is_integral<T>::value
+					     && !std::is_same<T, bool>::value>::type>
+{
+  static uint64_t get(T k)
+  {
+    typedef typename std::make_unsigned<T>::type U;
+    U u = static_cast<U>(k);
+    if (std::is_signed<T>::value)
+      u ^= static_cast<U>(U(1) << (sizeof(T) * 8 - 1));
+    return static_cast<uint64_t>(u);
+  }
+};
+
+template<class T>
+struct key_prefix<T, typename std::enable_if<std::is_floating_point<T>::value
+					     && sizeof(T) <= 8>::type>
+{
+  static uint64_t get(T k)
+  {
+    // flip all bits of negative numbers, only the sign bit of positive ones.
+    uint64_t u = 0;
+    if (sizeof(T) == 8)
+      std::memcpy(&u, &k, 8);
+    else
+      {
+	uint32_t w;
+	std::memcpy(&w, &k, 4);
+	u = static_cast<uint64_t>(w) << 32;
+      }
+    const uint64_t sign = uint64_t(1) << 63;
+    return (u & sign) ? ~u : u ^ sign;
+  }
+};
+
+template<class C, class Tr, class A>
+struct key_prefix<std::basic_string<C, Tr, A>,
+		  typename std::enable_if<sizeof(C) == 1>::type>
+{
+  static uint64_t get(const std::basic_string<C, Tr, A> &k)
+  {
+    // first eight bytes, big-endian, zero-padded.
+    uint64_t u = 0;
+    std::size_t len = k.size() < 8 ? k.size() : 8;
+    for (std::size_t i = 0; i < len; i++)
+      u |= static_cast<uint64_t>(static_cast<unsigned char>(k[i])) << (56 - 8 * i);
+    return u;
+  }
+};
+
+template<class A, class B>
+struct key_prefix<std::pair<A, B>>
+{
+  static uint64_t get(const std::pair<A, B> &k)
+  {
+    return key_prefix<A>::get(k.first);
+  }
+};
+
+template<class A, class... Rest>
+struct key_prefix<std::tuple<A, Rest...>>
+{
+  static uint64_t get(const std::tuple<A, Rest...> &k)
+  {
+    return key_prefix<A>::get(std::get<0>(k));
+  }
+};
+
+/*
+ * a key along with its cached prefix.
+ */
+template<class T>
+struct prefixed_key
+{
+  prefixed_key(T k)
+    :prefix(key_prefix<T>::get(k)),key(std::move(k))
+  {
+  }
+
+  operator const T&() const
+  {
+    return key;
+  }
+
+  bool operator==(const prefixed_key &o) const
+  {
+    return prefix == o.prefix && key == o.key;
+  }
+
+  uint64_t prefix;
+  T key;
+};
+
+/*
+ * comparators, only falling back to the key comparison on prefix ties.
+ * The prefix order is ascending, so the key comparator must be std::less-like
+ * for prefix_less and std::greater-like for prefix_greater.
+ */
+template<class T, class Comp = std::less<T>>
+struct prefix_less
+{
+  bool operator()(const prefixed_key<T> &x, const prefixed_key<T> &y) const
+  {
+    if (x.prefix != y.prefix)
+      return x.prefix < y.prefix;
+    return comp(x.key, y.key);
+  }
+
+  Comp comp;
+};
+
+template<class T, class Comp = std::greater<T>>
+struct prefix_greater
+{
+  bool operator()(const prefixed_key<T> &x, const prefixed_key<T> &y) const
+  {
+    if (x.prefix != y.prefix)
+      return x.prefix > y.prefix;
+    return comp(x.key, y.key);
+  }
+
+  Comp comp;
+};
+
+template<class T>
+std::ostream& operator<<(std::ostream &os, const prefixed_key<T> &k)
+{
+  return os << k.key;
+}
+
+namespace std
+{
+  template<class T>
+  struct hash<prefixed_key<T>>
+  {
+    size_t operator()(const prefixed_key<T> &k) const
+    {
+      return hash<T>()(k.key);
+    }
+  };
+}
+
+template<class T, class Comp = prefix_less<T>>
+using FibPrefixHeap = FibHeap<prefixed_key<T>, Comp>;
+
+template<class T, class Comp = prefix_less<T>>
+using FibPrefixQueue = FibQueue<prefixed_key<T>, Comp>;
+
+#endif
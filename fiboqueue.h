@@ -29,91 +29,127 @@
 #include <unordered_map>
 #include <algorithm>
 
-template<class T, class Comp = std::less<T>>
-class FibQueue : public FibHeap<T, Comp>
+/*
+ * handle policy of FibQueue: a fast store from keys to the nodes that hold
+ * them, kept in sync by the heap through inserts, key changes and removals.
+ */
+template<class T, class Node>
+class fib_key_handles
 {
  public:
-  using Heap = FibHeap<T, Comp>;
-  using Node = typename Heap::FibNode;
-  using KeyNodeIter = typename std::unordered_map<T, Node*>::iterator;
+  static const bool enabled = true;
 
-  FibQueue()
-    : Heap()
+  fib_key_handles()
     {
     }
 
-  FibQueue(Comp comp)
-      : Heap(comp)
+  // the entries point to the nodes of one heap, a copy indexes its own.
+  fib_key_handles(const fib_key_handles&)
+    {
+    }
+
+  fib_key_handles(fib_key_handles&&) = default;
+  fib_key_handles& operator=(fib_key_handles&&) = default;
+
+  void handle_insert(Node *x)
   {
+    fstore.insert({ x->key, x });
   }
 
-  ~FibQueue()
-    {
-    }
+  /*
+   * erases the fast store entry of x, among those with the same key.
+   */
+  void handle_erase(Node *x)
+  {
+    auto range = fstore.equal_range(x->key);
+    auto mit = std::find_if(range.first, range.second,
+                            [x](const std::pair<const T, Node*> &ele){
+                                return ele.second == x;
+                            }
+    );
+    if (mit != range.second)
+      fstore.erase(mit);
+    else std::cerr << "[Error]: key " << x->key << " cannot be found in FiboQueue fast store\n";
+  }
 
-  void decrease_key(Node *x, T k)
+  void handle_rekey_begin(Node *x)
   {
-    KeyNodeIter mit = find(x->key);
-    fstore.erase(mit);
-    fstore.insert({ k, x });
-    Heap::decrease_key(x,std::move(k));
+    handle_erase(x);
   }
 
-  Node* push(T k, void *pl)
+  void handle_rekey_end(Node *x)
   {
-    Node *x = Heap::push(std::move(k),pl);
-    fstore.insert({ k, x });
-    return x;
+    handle_insert(x);
   }
 
-  Node* push(T k)
+  void handle_clear()
   {
-    return push(std::move(k),NULL);
+    fstore.clear();
   }
 
-  KeyNodeIter find(const T& k)
+  void handle_reserve(std::size_t n)
   {
-    KeyNodeIter mit = fstore.find(k);
-    return mit;
+    fstore.reserve(n);
   }
 
-  int count(const T& k)
+  std::unordered_multimap<T, Node*> fstore;
+};
+
+template<class T, class Comp = std::less<T>, bool Stable = false, class Payload = void*, class Alloc = std::allocator<T>, class Stats = fib_no_stats,
+         class Parallel = fib_no_parallel>
+class FibQueue : public FibHeap<T, Comp, Stable, Payload, Alloc, Stats, Parallel, fib_key_handles<T, fib_node<T, Payload> > >
+{
+ public:
+  using Heap = FibHeap<T, Comp, Stable, Payload, Alloc, Stats, Parallel, fib_key_handles<T, fib_node<T, Payload> > >;
+  using payload_type = typename Heap::payload_type;
+  using Node = typename Heap::FibNode;
+  using KeyNodeIter = typename std::unordered_map<T, Node*>::iterator;
+
+  FibQueue()
+    : Heap()
+    {
+    }
+
+  FibQueue(Comp comp, const Alloc &a = Alloc())
+      : Heap(comp, a)
   {
-      KeyNodeIter mit = fstore.find(k);
-      return mit != fstore.end();
   }
 
-  Node* findNode(const T& k)
+  // the heap copies index their own nodes.
+  FibQueue(const FibQueue&) = default;
+  FibQueue(FibQueue&&) = default;
+  FibQueue& operator=(const FibQueue&) = default;
+  FibQueue& operator=(FibQueue&&) = default;
+
+  FibQueue clone() const
   {
-    KeyNodeIter mit = find(k);
-    return mit->second;
+    return FibQueue(*this);
   }
 
-  void pop()
+  ~FibQueue()
+    {
+    }
+
+  KeyNodeIter find(const T& k)
   {
-    if (Heap::empty())
-      return;
-    Node *x = Heap::extract_min();
-    if (!x)
-      return; // should not happen.
-    auto range = fstore.equal_range(x->key);
-    auto mit = std::find_if(range.first, range.second,
-                            [x](const std::pair<T, Node*> &ele){
-                                return ele.second == x;
-                            }
-    );
-    if (mit != range.second)
-      fstore.erase(mit);
-    else std::cerr << "[Error]: key " << x->key << " cannot be found in FiboQueue fast store\n";
-    delete x;
+    KeyNodeIter mit = Heap::fstore.find(k);
+    return mit;
   }
 
-  void clear() {
-      Heap::clear();
-      fstore.clear();
+  int count(const T& k)
+  {
+      KeyNodeIter mit = Heap::fstore.find(k);
+      return mit != Heap::fstore.end();
   }
 
-  std::unordered_multimap<T, Node*> fstore;
+  Node* findNode(const T& k)
+  {
+    KeyNodeIter mit = find(k);
+    return mit->second;
+  }
 };
 
+template<class Key, class Value, class Comp = std::less<Key>>
+using TypedFibQueue = FibQueue<Key, Comp, false, Value>;
+
 #endif
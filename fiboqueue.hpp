@@ -17,82 +17,27 @@
  */
 
 /**
- * This is basically a Fibonacci heap with an added fast store for retrieving
- * vertices, and decrease their key as needed. Useful for search algorithms (e.g.
- * Dijstra, heuristic, ...).
+ * Former fibonacci_queue<T> API over FibQueue<T> in fiboqueue.h, with the
+ * same forwarding members as fibonacci_heap<T>.
  */
 
 #ifndef FIBOQUEUE_HPP
 #define FIBOQUEUE_HPP
 
 #include "fiboheap.hpp"
+#include "fiboqueue.h"
 
-#include <unordered_map>
-#include <algorithm>
-
-namespace fibonacci_heap::fibonacci_queue {
-	template<class T>
-	class fibonacci_queue : public fibonacci_heap<T> {
-		/* atributes */
-			private:
-				std::unordered_multimap<T, c_node*> fstore;
-		/* members */
+namespace fibonacci_heap {
+	namespace fibonacci_queue {
+		template<class T>
+		class fibonacci_queue : public FibQueue<T> {
 			public:
-				// constructors
-					fibonacci_queue() {}
-					fibonacci_queue(const fibonacci_queue& other) : fibonacci_heap<T>::n(other.n), fstore(other.fstore), fibonacci_heap<T>::min(other.min) {}
-					fibonacci_queue(fibonacci_queue&& other) noexcept : fibonacci_heap<T>::n(other.n), fstore(other.fstore), fibonacci_heap<T>::min(other.min) { delete_nodes(other.min); }
-				// destructor
-					~fibonacci_queue() noexcept {}
-				// operators
-					fibonacci_queue& operator=(const fibonacci_queue& other) {
-						fibonacci_heap<T>::n = other.n;
-						fibonacci_heap<T>::min = other.min;
-						fstore = other.fstore;
-					}
-					fibonacci_queue& operator=(fibonacci_queue&& other) noexcept {
-						fibonacci_heap<T>::n = other.n;
-						fibonacci_heap<T>::min = other.min;
-						fstore = other.fstore;
-						delete_nodes(other.min);
-					}
-				// accessors
-					auto find(T k) { return fstore.find(k); }
-					c_node* findNode(T k) { return find(k)->second; }
-				// modifiers
-					[[noreturn]] void decrease_key(c_node* x, int k) {
-						fstore.erase(find(fibonacci_heap<T>::to_T(&x->key)));
-						fstore.emplace(k, x);
-						fibonacci_heap<T>::decrease_key(x, k);
-					}
-					void pop() {
-						if(fibonacci_heap<T>::empty())
-							return;
-						c_node* x = fibonacci_heap<T>::extract_min();
-						auto range = fstore.equal_range(fibonacci_heap<T>::to_T(&x->key));
-						auto mit = find_if(range.first, range.second,
-							[x](const auto& element) {
-								return element.second == x;
-							}
-						);
-						if(mit != range.second)
-							fstore.erase(mit);
-						else
-							std::cerr << "[Error]: key " << fibonacci_heap<T>::to_T(&x->key) << " cannot be found in FiboQueue fast store" << std::endl;
-						delete x;
-					}
-					c_node* push(const T& k, void* pl = nullptr) {
-						auto x = fibonacci_heap<T>::push(k, pl);
-						fstore.emplace(k, x);
-						return x;
-					}
-					c_node* push(T&& k, void* pl = nullptr) {
-						auto x = fibonacci_heap<T>::push(k, pl);
-						fstore.emplace(k, x);
-						k = nullptr;
-						return x;
-					}
-	};
+				typedef typename FibQueue<T>::FibNode c_node;
+				using FibQueue<T>::FibQueue;
+				c_node* create_c_node_on_heap(T k, void* pl = nullptr) { return this->push(std::move(k), pl); }
+				void remove_c_node(c_node* x) { this->remove_fibnode(x); }
+		};
+	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,313 @@
+/**
+ * Fibonacci Heap snapshots
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Saves and restores the exact forest of a heap or queue, so that a restart
+ * skips the comparisons and consolidations of n push() and pop() calls. Each
+ * node is still allocated on its own through create_node(), as the heap frees
+ * nodes one by one; the file is mapped once and its links are fixed up in a
+ * linear pass.
+ *
+ * The file is a header followed by one fixed-size record per node, with links
+ * stored as record indices. Keys must be trivially copyable, and payloads are
+ * saved as integer ids: the void* payload is stored as is, so it should carry
+ * an id (e.g. an index cast to void*) rather than an address.
+ */
+
+#ifndef FIBOSNAPSHOT_H
+#define FIBOSNAPSHOT_H
+
+#include "fiboheap.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <math.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct fib_snapshot_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t key_size;
+  uint64_t record_size;
+  uint64_t n;
+};
+
+template<class T>
+struct fib_snapshot_record
+{
+  T key;
+  uint64_t payload;
+  uint64_t p;
+  uint64_t left;
+  uint64_t right;
+  uint64_t child;
+  uint64_t seq;
+  int32_t degree;
+  uint8_t mark;
+};
+
+static const char fib_snapshot_magic[8] = { 'F','I','B','H','E','A','P','1' };
+static const uint64_t fib_snapshot_nil = ~uint64_t(0);
+
+/*
+ * checks that n records form a forest rooted at the ring of record 0, as
+ * fib_save() writes it: links within the records, closed sibling rings whose
+ * parent is the record pointing to them with that many children, no record
+ * reached twice and none left over, and degrees within the Fibonacci bound
+ * that consolidate() sizes its table by.
+ */
+template<class Record>
+bool fib_snapshot_valid(const Record *records, uint64_t n)
+{
+  if (n == 0)
+    return true;
+  if (n > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+    return false;
+  int max_degree = static_cast<int>(floor(log(static_cast<double>(n))/log(static_cast<double>(1 + sqrt(static_cast<double>(5)))/2)));
+  std::vector<bool> seen(n, false);
+  uint64_t count = 0;
+  // (first record of a ring, their parent)
+  std::vector<std::pair<uint64_t, uint64_t> > rings(1, std::make_pair(uint64_t(0), fib_snapshot_nil));
+  while (!rings.empty())
+    {
+      uint64_t first = rings.back().first, parent = rings.back().second;
+      rings.pop_back();
+      uint64_t i = first, len = 0;
+      do
+	{
+	  if (i >= n || seen[i])
+	    return false;
+	  const Record &r = records[i];
+	  if (r.p != parent || r.left >= n || r.right >= n || records[r.right].left != i
+	      || r.degree < 0 || r.degree > max_degree)
+	    return false;
+	  if (r.child != fib_snapshot_nil)
+	    rings.push_back(std::make_pair(r.child, i));
+	  else if (r.degree != 0)
+	    return false;
+	  seen[i] = true;
+	  count++;
+	  len++;
+	  i = r.right;
+	} while (i != first);
+      if (parent != fib_snapshot_nil && len != static_cast<uint64_t>(records[parent].degree))
+	return false;
+    }
+  return count == n;
+}
+
+/*
+ * save(H,path)
+ * Rings of siblings are written contiguously, breadth-first from the root
+ * list, which starts at H.min so that H.min is record 0.
+ */
+template<class T, class Comp, bool Stable, class Alloc, class Stats, class Parallel, class Handles>
+bool fib_save(const FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles> &heap, const std::string &path)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "snapshot keys must be trivially copyable");
+  typedef typename FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles>::FibNode FibNode;
+  typedef fib_snapshot_record<T> Record;
+
+  std::FILE *f = std::fopen(path.c_str(), "wb");
+  if (!f)
+    {
+      std::cerr << "[Error]: cannot open snapshot " << path << " for writing\n";
+      return false;
+    }
+  std::vector<char> buf(1 << 20);
+  std::setvbuf(f, buf.data(), _IOFBF, buf.size());
+
+  fib_snapshot_header h;
+  std::memcpy(h.magic, fib_snapshot_magic, sizeof(h.magic));
+  h.version = 1;
+  h.key_size = sizeof(T);
+  h.record_size = sizeof(Record);
+  h.n = heap.n;
+  bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+
+  std::vector<FibNode*> order;
+  order.reserve(heap.n);
+  std::vector<uint64_t> parent;
+  parent.reserve(heap.n);
+  std::vector<uint64_t> ring_start, ring_len;
+  ring_start.reserve(heap.n);
+  ring_len.reserve(heap.n);
+
+  // appends the ring starting at x, returns its first index.
+  auto add_ring = [&](FibNode *x, uint64_t p) -> uint64_t
+    {
+      uint64_t start = order.size();
+      FibNode *w = x;
+      do
+	{
+	  order.push_back(w);
+	  parent.push_back(p);
+	  w = w->right;
+	} while (w != x);
+      uint64_t len = order.size() - start;
+      for (uint64_t i = 0; i < len; i++)
+	{
+	  ring_start.push_back(start);
+	  ring_len.push_back(len);
+	}
+      return start;
+    };
+
+  if (heap.min)
+    add_ring(heap.min, fib_snapshot_nil);
+  Record r;
+  std::memset(&r, 0, sizeof(r));
+  for (uint64_t i = 0; ok && i < order.size(); i++)
+    {
+      FibNode *x = order[i];
+      uint64_t s = ring_start[i], l = ring_len[i];
+      std::memcpy(&r.key, &x->key, sizeof(T));
+      r.payload = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(x->payload));
+      r.p = parent[i];
+      r.left = i == s ? s + l - 1 : i - 1;
+      r.right = i == s + l - 1 ? s : i + 1;
+      r.child = x->child ? add_ring(x->child, i) : fib_snapshot_nil;
+      r.seq = x->seq;
+      r.degree = x->degree;
+      r.mark = x->mark;
+      ok = std::fwrite(&r, sizeof(r), 1, f) == 1;
+    }
+
+  if (std::fclose(f) != 0)
+    ok = false;
+  if (!ok)
+    std::cerr << "[Error]: failed writing snapshot " << path << std::endl;
+  return ok;
+}
+
+/*
+ * load(H,path)
+ * Maps the file and rebuilds the forest verbatim: no comparison and no
+ * consolidation. One node is allocated per record, then a linear pass over the
+ * records turns indices into pointers.
+ * Queues, or any heap with a handle policy, then index the loaded nodes.
+ */
+template<class T, class Comp, bool Stable, class Alloc, class Stats, class Parallel, class Handles>
+bool fib_load(FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles> &heap, const std::string &path,
+	      std::vector<typename FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles>::FibNode*> &nodes)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "snapshot keys must be trivially copyable");
+  typedef typename FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles>::FibNode FibNode;
+  typedef fib_snapshot_record<T> Record;
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+      std::cerr << "[Error]: cannot open snapshot " << path << std::endl;
+      return false;
+    }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(fib_snapshot_header))
+    {
+      ::close(fd);
+      std::cerr << "[Error]: snapshot " << path << " is truncated\n";
+      return false;
+    }
+  size_t size = static_cast<size_t>(st.st_size);
+  void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    {
+      std::cerr << "[Error]: cannot map snapshot " << path << std::endl;
+      return false;
+    }
+  ::madvise(map, size, MADV_SEQUENTIAL);
+
+  const fib_snapshot_header *h = static_cast<const fib_snapshot_header*>(map);
+  if (std::memcmp(h->magic, fib_snapshot_magic, sizeof(h->magic)) != 0
+      || h->version != 1 || h->key_size != sizeof(T) || h->record_size != sizeof(Record)
+      || h->n > (size - sizeof(*h)) / sizeof(Record))
+    {
+      ::munmap(map, size);
+      std::cerr << "[Error]: snapshot " << path << " does not match this heap type\n";
+      return false;
+    }
+
+  const Record *records = reinterpret_cast<const Record*>(static_cast<const char*>(map) + sizeof(*h));
+  uint64_t n = h->n;
+  // the heap is left alone unless the whole forest checks out.
+  if (!fib_snapshot_valid(records, n))
+    {
+      ::munmap(map, size);
+      std::cerr << "[Error]: snapshot " << path << " is corrupt\n";
+      return false;
+    }
+  heap.clear();
+  nodes.assign(n, nullptr);
+  uint64_t created = 0;
+  try
+    {
+      for (; created < n; created++)
+	{
+	  T k;
+	  std::memcpy(&k, &records[created].key, sizeof(T));
+	  nodes[created] = heap.create_node(k, reinterpret_cast<void*>(static_cast<uintptr_t>(records[created].payload)));
+	}
+    }
+  catch (...)
+    {
+      for (uint64_t i = 0; i < created; i++)
+	heap.destroy_node(nodes[i]);
+      nodes.clear();
+      ::munmap(map, size);
+      throw;
+    }
+  for (uint64_t i = 0; i < n; i++)
+    {
+      const Record &r = records[i];
+      FibNode *x = nodes[i];
+      x->p = r.p == fib_snapshot_nil ? nullptr : nodes[r.p];
+      x->left = nodes[r.left];
+      x->right = nodes[r.right];
+      x->child = r.child == fib_snapshot_nil ? nullptr : nodes[r.child];
+      x->seq = r.seq;
+      x->degree = r.degree;
+      x->mark = r.mark != 0;
+      heap.advance_sequence(r.seq + 1);
+    }
+  heap.min = n ? nodes[0] : nullptr;
+  heap.n = static_cast<int>(n);
+  if (Handles::enabled)
+    heap.index_handles();
+  ::munmap(map, size);
+  return true;
+}
+
+template<class T, class Comp, bool Stable, class Alloc, class Stats, class Parallel, class Handles>
+bool fib_load(FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles> &heap, const std::string &path)
+{
+  std::vector<typename FibHeap<T, Comp, Stable, void*, Alloc, Stats, Parallel, Handles>::FibNode*> nodes;
+  return fib_load(heap, path, nodes);
+}
+
+#endif
@@ -0,0 +1,358 @@
+/**
+ * Soft heap
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Approximate priority queue after Kaplan and Zwick (2009) "A simpler
+ * implementation and analysis of Chazelle's soft heaps", SODA, for consumers
+ * that can take some pops out of order, such as sampling top candidates or
+ * shedding load.
+ *
+ * Items share lists in the nodes of binary trees, and a list is ranked by a
+ * common key no smaller than any of its items' keys: an item whose key was
+ * raised that way is corrupted, and at most eps times the number of pushes
+ * are corrupted at any time. In exchange, push and pop take O(log 1/eps)
+ * amortized time whatever the size, plus for pop a walk over the roots below
+ * the one popped.
+ *
+ *   FibSoftHeap<int> sh(0.1);
+ *   sh.push(5);
+ *   bool late = sh.top_corrupted(); // top() may not be the smallest key
+ *   sh.pop();
+ */
+
+#ifndef FIBOSOFT_H
+#define FIBOSOFT_H
+
+#include "fiboheap.h"
+#include "fibopool.h"
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <math.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+template<class T, class Comp = std::less<T>>
+class FibSoftHeap
+{
+ public:
+  /*
+   * eps in (0, 1): the fraction of pushed items that may be corrupted.
+   */
+  FibSoftHeap(double eps = 0.1, Comp comp = Comp())
+    :eps(eps),threshold(0),n(0),comp(comp)
+  {
+    if (!(eps > 0.0 && eps < 1.0))
+      {
+	std::cerr << "[Error]: FibSoftHeap error rate must be in (0,1), using 0.1\n";
+	this->eps = 0.1;
+      }
+    threshold = static_cast<int>(ceil(log2(1.0 / this->eps))) + 5;
+  }
+
+  ~FibSoftHeap()
+    {
+      clear();
+    }
+
+  FibSoftHeap(const FibSoftHeap&) = delete;
+  FibSoftHeap& operator=(const FibSoftHeap&) = delete;
+
+  void clear()
+  {
+    std::vector<node*> todo;
+    for (node *r : roots)
+      if (r)
+	todo.push_back(r);
+    while (!todo.empty())
+      {
+	node *x = todo.back();
+	todo.pop_back();
+	if (x->left)
+	  todo.push_back(x->left);
+	if (x->right)
+	  todo.push_back(x->right);
+	free_items(x);
+	free_node(x);
+      }
+    roots.clear();
+    sufmin.clear();
+    n = 0;
+  }
+
+  void push(T k)
+  {
+    node *carry = new (nodes.allocate()) node(0, 1);
+    carry->first = carry->last = new (items.allocate()) item(std::move(k));
+    carry->count = 1;
+    carry->ckey = carry->first->key;
+    // binary increment, linking the trees of equal ranks.
+    std::size_t r = 0;
+    for (; r < roots.size() && roots[r]; r++)
+      {
+	carry = link(roots[r], carry);
+	roots[r] = nullptr;
+      }
+    if (r == roots.size())
+      {
+	roots.push_back(nullptr);
+	sufmin.push_back(nullptr);
+      }
+    roots[r] = carry;
+    update_sufmin(r);
+    ++n;
+  }
+
+  /*
+   * the item pop() removes, a smallest key up to corruption.
+   */
+  const T& top() const
+  {
+    return sufmin[0]->first->key;
+  }
+
+  /*
+   * the key the top item was ranked with, never smaller than top().
+   */
+  const T& top_ckey() const
+  {
+    return sufmin[0]->ckey;
+  }
+
+  /*
+   * whether the key of the top item was raised, so that it may come out
+   * after items of larger keys.
+   */
+  bool top_corrupted() const
+  {
+    return comp(top(), top_ckey());
+  }
+
+  void pop()
+  {
+    if (empty())
+      return;
+    node *x = sufmin[0];
+    item *e = x->first;
+    x->first = e->next;
+    if (!x->first)
+      x->last = nullptr;
+    x->count--;
+    free_item(e);
+    std::size_t r = x->rank;
+    if (x->count == 0)
+      {
+	if (leaf(x))
+	  {
+	    free_node(x);
+	    roots[r] = nullptr;
+	  }
+	else
+	  sift(x);
+      }
+    update_sufmin(r);
+    --n;
+  }
+
+  /*
+   * calls f(key, ckey) for every corrupted item in the heap.
+   */
+  template<class F>
+  void for_each_corrupted(F f) const
+  {
+    std::vector<const node*> todo;
+    for (const node *r : roots)
+      if (r)
+	todo.push_back(r);
+    while (!todo.empty())
+      {
+	const node *x = todo.back();
+	todo.pop_back();
+	if (x->left)
+	  todo.push_back(x->left);
+	if (x->right)
+	  todo.push_back(x->right);
+	for (const item *e = x->first; e; e = e->next)
+	  if (comp(e->key, x->ckey))
+	    f(e->key, x->ckey);
+      }
+  }
+
+  std::size_t corrupted_count() const
+  {
+    std::size_t c = 0;
+    for_each_corrupted([&c](const T&, const T&) { c++; });
+    return c;
+  }
+
+  bool empty() const
+  {
+    return n == 0;
+  }
+
+  std::size_t size() const
+  {
+    return n;
+  }
+
+  double error_rate() const
+  {
+    return eps;
+  }
+
+ private:
+  struct item
+  {
+    item(T k)
+      :key(std::move(k)),next(nullptr)
+    {
+    }
+
+    T key;
+    item *next;
+  };
+
+  struct node
+  {
+    node(int rank, std::size_t target)
+      :ckey(),rank(rank),target(target),count(0),left(nullptr),right(nullptr),first(nullptr),last(nullptr)
+    {
+    }
+
+    T ckey; // no smaller than the key of any item in the list.
+    int rank;
+    std::size_t target; // list length sift() fills up to.
+    std::size_t count;
+    node *left;
+    node *right;
+    item *first;
+    item *last;
+  };
+
+  static bool leaf(const node *x)
+  {
+    return !x->left && !x->right;
+  }
+
+  /*
+   * lists hold one item up to the threshold rank, then grow by half per rank.
+   */
+  std::size_t target_size(int rank, const node *child) const
+  {
+    if (rank <= threshold)
+      return 1;
+    return (3 * child->target + 1) / 2;
+  }
+
+  node* link(node *x, node *y)
+  {
+    node *z = new (nodes.allocate()) node(x->rank + 1, 1);
+    z->target = target_size(z->rank, x);
+    z->left = x;
+    z->right = y;
+    sift(z);
+    return z;
+  }
+
+  /*
+   * moves the list of the child with the smaller ckey up into x, until x
+   * holds target items or has no children left.
+   */
+  void sift(node *x)
+  {
+    while (x->count < x->target && !leaf(x))
+      {
+	if (!x->left || (x->right && comp(x->right->ckey, x->left->ckey)))
+	  std::swap(x->left, x->right);
+	node *c = x->left;
+	if (x->last)
+	  x->last->next = c->first;
+	else
+	  x->first = c->first;
+	x->last = c->last;
+	x->count += c->count;
+	x->ckey = c->ckey;
+	c->first = c->last = nullptr;
+	c->count = 0;
+	if (leaf(c))
+	  {
+	    free_node(c);
+	    x->left = x->right;
+	    x->right = nullptr;
+	  }
+	else
+	  sift(c);
+      }
+  }
+
+  /*
+   * sufmin[i] is the root of smallest ckey among ranks i and up.
+   */
+  void update_sufmin(std::size_t r)
+  {
+    while (!roots.empty() && !roots.back())
+      {
+	roots.pop_back();
+	sufmin.pop_back();
+      }
+    if (roots.empty())
+      return;
+    if (r >= roots.size())
+      r = roots.size() - 1;
+    for (std::size_t i = r + 1; i-- > 0;)
+      {
+	node *next = i + 1 < roots.size() ? sufmin[i + 1] : nullptr;
+	node *x = roots[i];
+	sufmin[i] = !x || (next && comp(next->ckey, x->ckey)) ? next : x;
+      }
+  }
+
+  void free_items(node *x)
+  {
+    for (item *e = x->first; e;)
+      {
+	item *next = e->next;
+	free_item(e);
+	e = next;
+      }
+  }
+
+  void free_item(item *e)
+  {
+    e->~item();
+    items.deallocate(e);
+  }
+
+  void free_node(node *x)
+  {
+    x->~node();
+    nodes.deallocate(x);
+  }
+
+  double eps;
+  int threshold; // ranks up to this one hold a single item, so never corrupt.
+  std::size_t n;
+  Comp comp;
+  std::vector<node*> roots; // by rank, at most one tree per rank.
+  std::vector<node*> sufmin;
+  fib_node_pool<node> nodes;
+  fib_node_pool<item> items;
+};
+
+#endif
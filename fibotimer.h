@@ -0,0 +1,200 @@
+/**
+ * Fibonacci Timer Queue
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Timers keyed by deadline on top of a Fibonacci heap. A timer handle is its
+ * heap node, which holds the callback, so that arming a timer is a single
+ * allocation; it is valid until the timer fires or is cancelled. Rescheduling moves
+ * the node in either direction without reallocating it, and cancelling unlinks
+ * it without a sentinel key and without consolidating unless it was the earliest.
+ */
+
+#ifndef FIBOTIMER_H
+#define FIBOTIMER_H
+
+#include "fiboheap.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#ifdef __linux__
+#include <cerrno>
+#include <ctime>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+template<class Clock = std::chrono::steady_clock, class Callback = std::function<void()>>
+class FibTimerQueue
+{
+ public:
+  using time_point = typename Clock::time_point;
+  using Heap = FibHeap<time_point, std::less<time_point>, false, Callback>;
+  using Timer = typename Heap::FibNode;
+
+  FibTimerQueue()
+    {
+    }
+
+  ~FibTimerQueue()
+    {
+      clear();
+    }
+
+  FibTimerQueue(const FibTimerQueue&) = delete;
+  FibTimerQueue& operator=(const FibTimerQueue&) = delete;
+
+  /*
+   * cancels all pending timers.
+   */
+  void clear()
+  {
+    heap.clear();
+  }
+
+  Timer* schedule(time_point deadline, Callback cb)
+  {
+    return heap.emplace(deadline, std::move(cb));
+  }
+
+  /*
+   * moves timer t to a new deadline, earlier or later.
+   */
+  void reschedule(Timer *t, time_point deadline)
+  {
+    heap.update_key(t, deadline);
+  }
+
+  void cancel(Timer *t)
+  {
+    heap.remove_fibnode(t);
+  }
+
+  /*
+   * fires every timer whose deadline is not after now, earliest first.
+   * Callbacks may schedule, reschedule or cancel other timers.
+   * Returns the number of timers fired.
+   */
+  std::size_t expire_until(time_point now)
+  {
+    std::size_t fired = 0;
+    while (!heap.empty() && !(now < heap.top()))
+      {
+	Timer *t = heap.extract_min();
+	// moved out first, so that the callback may touch the queue.
+	Callback cb(std::move(t->payload));
+	heap.destroy_node(t);
+	cb();
+	++fired;
+      }
+    return fired;
+  }
+
+  /*
+   * earliest pending deadline, the queue must not be empty.
+   */
+  time_point next_deadline()
+  {
+    return heap.top();
+  }
+
+  bool empty() const
+  {
+    return heap.empty();
+  }
+
+  unsigned int size()
+  {
+    return heap.size();
+  }
+
+ private:
+  Heap heap;
+};
+
+#ifdef __linux__
+/*
+ * Linux timerfd adapter, so that an epoll loop can wait on the earliest
+ * deadline of a steady_clock timer queue. Register fd() for EPOLLIN, call
+ * arm() whenever the earliest deadline may have changed, and dispatch() when
+ * the fd is readable.
+ */
+template<class Callback = std::function<void()>>
+class FibTimerFd
+{
+ public:
+  using Queue = FibTimerQueue<std::chrono::steady_clock, Callback>;
+
+  FibTimerFd(Queue &q)
+    :queue(q),tfd(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+  {
+  }
+
+  ~FibTimerFd()
+    {
+      if (tfd >= 0)
+	::close(tfd);
+    }
+
+  FibTimerFd(const FibTimerFd&) = delete;
+  FibTimerFd& operator=(const FibTimerFd&) = delete;
+
+  int fd() const
+  {
+    return tfd;
+  }
+
+  /*
+   * sets the timerfd to the earliest deadline, or disarms it when the queue is empty.
+   */
+  bool arm()
+  {
+    struct itimerspec its = {};
+    if (!queue.empty())
+      {
+	// steady_clock counts from the same origin as CLOCK_MONOTONIC on Linux.
+	int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(queue.next_deadline().time_since_epoch()).count();
+	if (ns <= 0)
+	  ns = 1; // a zero it_value would disarm the timer.
+	its.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+	its.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+      }
+    return ::timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, nullptr) == 0;
+  }
+
+  /*
+   * drains the fd, fires the expired timers and rearms.
+   */
+  std::size_t dispatch()
+  {
+    uint64_t expirations;
+    while (::read(tfd, &expirations, sizeof(expirations)) < 0 && errno == EINTR)
+      ;
+    std::size_t fired = queue.expire_until(std::chrono::steady_clock::now());
+    arm();
+    return fired;
+  }
+
+ private:
+  Queue &queue;
+  int tfd;
+};
+#endif
+
+#endif
@@ -0,0 +1,667 @@
+/**
+ * Fibonacci Heap operation traces
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Records the operations made on a heap or queue, so that a production
+ * workload can be shared as a trace of keys and handle ids and replayed
+ * offline against any heap variant.
+ *
+ *   FibTraced<FibHeap<int64_t>> h("ops.trace"); // used as a FibHeap
+ *   ...
+ *   std::vector<fib_trace_op<int64_t>> ops;
+ *   fib_trace_read("ops.trace", ops);
+ *   fib_replay_stats s = fib_replay<fib_replay_adapter<FibHeap<int64_t>>>(ops);
+ *
+ * The file is a header, then one record per operation: an op byte, the
+ * handle id as a LEB128 varint except for push, whose id is implicitly the
+ * number of pushes before it, and the raw key for push and decrease_key.
+ * Keys must be trivially copyable. Records go through a buffer flushed in
+ * large writes; the recorder keeps a node to id hash map, so it is opt-in.
+ */
+
+#ifndef FIBOTRACE_H
+#define FIBOTRACE_H
+
+#include "fiboheap.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum fib_trace_kind
+{
+  fib_trace_push = 0,
+  fib_trace_pop = 1,
+  fib_trace_decrease_key = 2,
+  fib_trace_remove = 3
+};
+
+struct fib_trace_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t key_size;
+};
+
+static const char fib_trace_magic[8] = { 'F','I','B','T','R','A','C','E' };
+
+template<class T>
+struct fib_trace_op
+{
+  uint8_t kind;
+  uint64_t id;
+  T key; // push and decrease_key only.
+};
+
+/*
+ * buffered writer of trace records.
+ */
+class fib_trace_writer
+{
+ public:
+  fib_trace_writer(const std::string &path, uint32_t key_size, std::size_t buffer_size = std::size_t(1) << 20)
+    :f(std::fopen(path.c_str(), "wb")),buf(buffer_size > 64 ? buffer_size : 64),pos(0),ok(f != nullptr),path(path)
+  {
+    if (!f)
+      {
+	std::cerr << "[Error]: cannot open trace " << path << " for writing\n";
+	return;
+      }
+    fib_trace_header h;
+    std::memcpy(h.magic, fib_trace_magic, sizeof(h.magic));
+    h.version = 1;
+    h.key_size = key_size;
+    put(&h, sizeof(h));
+  }
+
+  ~fib_trace_writer()
+    {
+      close();
+    }
+
+  fib_trace_writer(const fib_trace_writer&) = delete;
+  fib_trace_writer& operator=(const fib_trace_writer&) = delete;
+
+  void record(uint8_t kind, uint64_t id, const void *key, std::size_t key_size)
+  {
+    if (pos + 1 + 10 + key_size > buf.size())
+      flush();
+    buf[pos++] = kind;
+    if (kind != fib_trace_push)
+      {
+	// LEB128: seven bits per byte, the high bit set on all but the last.
+	while (id >= 0x80)
+	  {
+	    buf[pos++] = static_cast<unsigned char>(id | 0x80);
+	    id >>= 7;
+	  }
+	buf[pos++] = static_cast<unsigned char>(id);
+      }
+    if (key)
+      put(key, key_size);
+  }
+
+  /*
+   * writes the buffered records out, false once a write has failed.
+   */
+  bool flush()
+  {
+    if (f && pos && std::fwrite(buf.data(), 1, pos, f) != pos)
+      fail();
+    pos = 0;
+    return ok;
+  }
+
+  bool close()
+  {
+    if (!f)
+      return ok;
+    flush();
+    if (std::fclose(f) != 0)
+      fail();
+    f = nullptr;
+    return ok;
+  }
+
+  bool good() const
+  {
+    return ok;
+  }
+
+ private:
+  void put(const void *p, std::size_t size)
+  {
+    if (pos + size > buf.size())
+      flush();
+    if (size > buf.size())
+      {
+	if (f && std::fwrite(p, 1, size, f) != size)
+	  fail();
+	return;
+      }
+    std::memcpy(&buf[pos], p, size);
+    pos += size;
+  }
+
+  void fail()
+  {
+    if (ok)
+      std::cerr << "[Error]: failed writing trace " << path << std::endl;
+    ok = false;
+  }
+
+  std::FILE *f;
+  std::vector<unsigned char> buf;
+  std::size_t pos;
+  bool ok;
+  std::string path;
+};
+
+/*
+ * A heap or queue that records push, pop, extract_min, their batched
+ * pop_n and extract_n, decrease_key and remove_fibnode to path. Other key
+ * changes are not recorded, and would make the replay diverge.
+ */
+template<class Heap>
+class FibTraced : public Heap
+{
+ public:
+  typedef typename Heap::FibNode Node;
+  typedef typename Heap::payload_type payload_type;
+  typedef typename std::decay<decltype(std::declval<Node&>().key)>::type key_type;
+
+  template<class... Args>
+  FibTraced(const std::string &path, Args&&... args)
+    :Heap(std::forward<Args>(args)...),trace(path, sizeof(key_type)),pushes(0),skipped(0)
+  {
+    static_assert(std::is_trivially_copyable<key_type>::value, "trace keys must be trivially copyable");
+  }
+
+  FibTraced(const FibTraced&) = delete;
+  FibTraced& operator=(const FibTraced&) = delete;
+
+  Node* push(key_type k)
+  {
+    return traced_push(Heap::push(std::move(k)));
+  }
+
+  Node* push(key_type k, payload_type pl)
+  {
+    return traced_push(Heap::push(std::move(k), std::move(pl)));
+  }
+
+  template<class... Args>
+  Node* emplace(key_type k, Args&&... args)
+  {
+    return traced_push(Heap::emplace(std::move(k), std::forward<Args>(args)...));
+  }
+
+  void pop()
+  {
+    if (Heap::empty())
+      return;
+    untrace(fib_trace_pop, Heap::min);
+    Heap::pop();
+  }
+
+  Node* extract_min()
+  {
+    if (Heap::min)
+      untrace(fib_trace_pop, Heap::min);
+    return Heap::extract_min();
+  }
+
+  // recorded as pops, in pop order.
+  std::vector<Node*> extract_n(std::size_t k)
+  {
+    std::vector<Node*> nodes = Heap::extract_n(k);
+    for (Node *x : nodes)
+      untrace(fib_trace_pop, x);
+    return nodes;
+  }
+
+  // the batch is recorded as popped even if writing a key throws.
+  template<class OutputIt>
+  OutputIt pop_n(std::size_t k, OutputIt out)
+  {
+    std::vector<Node*> nodes = extract_n(k);
+    std::size_t i = 0;
+    try
+      {
+	for (; i < nodes.size(); i++)
+	  {
+	    *out++ = std::move(nodes[i]->key);
+	    Heap::destroy_node(nodes[i]);
+	  }
+      }
+    catch (...)
+      {
+	for (; i < nodes.size(); i++)
+	  Heap::destroy_node(nodes[i]);
+	throw;
+      }
+    return out;
+  }
+
+  void decrease_key(Node *x, key_type k)
+  {
+    auto it = traced(x);
+    if (it != ids.end())
+      trace.record(fib_trace_decrease_key, it->second, &k, sizeof(k));
+    Heap::decrease_key(x, std::move(k));
+  }
+
+  void remove_fibnode(Node *x)
+  {
+    untrace(fib_trace_remove, x);
+    Heap::remove_fibnode(x);
+  }
+
+  // recorded as removes, in the order of the walk.
+  template<class Pred>
+  std::size_t erase_if(Pred pred)
+  {
+    return Heap::erase_if([this, &pred](Node *x) {
+	if (!pred(x))
+	  return false;
+	untrace(fib_trace_remove, x);
+	return true;
+      });
+  }
+
+  void clear()
+  {
+    Heap::for_each_node([this](Node *x) {
+	untrace(fib_trace_remove, x);
+      });
+    Heap::clear();
+  }
+
+  /*
+   * operations left out of the trace because their node was pushed around
+   * the recorder, e.g. through the Heap base.
+   */
+  uint64_t untraced() const
+  {
+    return skipped;
+  }
+
+  bool flush_trace()
+  {
+    return trace.flush();
+  }
+
+  fib_trace_writer trace;
+
+ private:
+  Node* traced_push(Node *x)
+  {
+    trace.record(fib_trace_push, 0, &x->key, sizeof(key_type));
+    ids[x] = pushes++;
+    return x;
+  }
+
+  void untrace(uint8_t kind, Node *x)
+  {
+    auto it = traced(x);
+    if (it == ids.end())
+      return;
+    trace.record(kind, it->second, nullptr, 0);
+    ids.erase(it);
+  }
+
+  /*
+   * the id of x, or end() for a node pushed around the recorder, which is
+   * counted and left out of the trace.
+   */
+  typename std::unordered_map<const Node*, uint64_t>::iterator traced(Node *x)
+  {
+    auto it = ids.find(x);
+    if (it == ids.end())
+      skipped++;
+    return it;
+  }
+
+  std::unordered_map<const Node*, uint64_t> ids;
+  uint64_t pushes;
+  uint64_t skipped;
+};
+
+/*
+ * reads the trace at path into ops, false if it is not a trace of T keys.
+ */
+template<class T>
+bool fib_trace_read(const std::string &path, std::vector<fib_trace_op<T>> &ops)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+      std::cerr << "[Error]: cannot open trace " << path << std::endl;
+      return false;
+    }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(fib_trace_header))
+    {
+      ::close(fd);
+      std::cerr << "[Error]: trace " << path << " is truncated\n";
+      return false;
+    }
+  size_t size = static_cast<size_t>(st.st_size);
+  void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    {
+      std::cerr << "[Error]: cannot map trace " << path << std::endl;
+      return false;
+    }
+  ::madvise(map, size, MADV_SEQUENTIAL);
+
+  const unsigned char *p = static_cast<const unsigned char*>(map);
+  const unsigned char *end = p + size;
+  fib_trace_header h;
+  std::memcpy(&h, p, sizeof(h));
+  p += sizeof(h);
+  bool ok = std::memcmp(h.magic, fib_trace_magic, sizeof(h.magic)) == 0
+    && h.version == 1 && h.key_size == sizeof(T);
+  if (!ok)
+    std::cerr << "[Error]: trace " << path << " does not match this key type\n";
+  uint64_t pushes = 0;
+  ops.clear();
+  while (ok && p < end)
+    {
+      fib_trace_op<T> op;
+      std::memset(&op, 0, sizeof(op));
+      op.kind = *p++;
+      if (op.kind > fib_trace_remove)
+	ok = false;
+      else if (op.kind == fib_trace_push)
+	op.id = pushes++;
+      else
+	{
+	  for (int shift = 0; ok; shift += 7)
+	    {
+	      if (p == end || shift > 63)
+		ok = false;
+	      else
+		{
+		  op.id |= static_cast<uint64_t>(*p & 0x7f) << shift;
+		  if (!(*p++ & 0x80))
+		    break;
+		}
+	    }
+	}
+      if (ok && (op.kind == fib_trace_push || op.kind == fib_trace_decrease_key))
+	{
+	  if (static_cast<size_t>(end - p) < sizeof(T))
+	    ok = false;
+	  else
+	    {
+	      std::memcpy(&op.key, p, sizeof(T));
+	      p += sizeof(T);
+	    }
+	}
+      if (ok)
+	ops.push_back(op);
+      else
+	std::cerr << "[Error]: trace " << path << " is corrupt after " << ops.size() << " operations\n";
+    }
+  ::munmap(map, size);
+  return ok;
+}
+
+/*
+ * replays a trace on Heap, a FibHeap or FibQueue with a void* payload, which
+ * carries the push id. Other heaps plug in with an adapter of the same shape.
+ */
+template<class Heap>
+struct fib_replay_adapter
+{
+  typedef typename Heap::FibNode* handle;
+  typedef typename std::decay<decltype(std::declval<typename Heap::FibNode&>().key)>::type key_type;
+
+  handle push(const key_type &k, uint64_t id)
+  {
+    return heap.push(k, reinterpret_cast<void*>(static_cast<uintptr_t>(id)));
+  }
+
+  // the push id of the top, which pop() removes.
+  uint64_t top_id()
+  {
+    return id(heap.topNode());
+  }
+
+  void pop()
+  {
+    heap.pop();
+  }
+
+  void decrease_key(handle x, const key_type &k)
+  {
+    heap.decrease_key(x, k);
+  }
+
+  void remove(handle x)
+  {
+    heap.remove_fibnode(x);
+  }
+
+  uint64_t id(handle x) const
+  {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(x->payload));
+  }
+
+  // whether the keys of x and y compare equal, as in a tie.
+  bool tied(handle x, handle y) const
+  {
+    return !heap.key_comp()(x->key, y->key) && !heap.key_comp()(y->key, x->key);
+  }
+
+  Heap heap;
+};
+
+/*
+ * latencies of one kind of operation, in nanoseconds.
+ */
+struct fib_replay_latency
+{
+  uint64_t count;
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  double max;
+};
+
+struct fib_replay_stats
+{
+  uint64_t ops; // replayed, all of them unless the trace diverged.
+  uint64_t mismatches; // pops of another key than the recorded heap popped.
+  double seconds;
+  double ops_per_second;
+  fib_replay_latency latency[4]; // by fib_trace_kind.
+  std::size_t peak_memory; // resident bytes above the start, 0 if unknown.
+};
+
+/*
+ * resident set size, and its peak, in bytes; 0 where /proc is missing.
+ */
+inline std::size_t fib_proc_status_bytes(const char *field)
+{
+  std::FILE *f = std::fopen("/proc/self/status", "r");
+  if (!f)
+    return 0;
+  char line[256];
+  std::size_t len = std::strlen(field), kb = 0;
+  while (std::fgets(line, sizeof(line), f))
+    if (std::strncmp(line, field, len) == 0 && line[len] == ':')
+      {
+	kb = std::strtoull(line + len + 1, nullptr, 10);
+	break;
+      }
+  std::fclose(f);
+  return kb * 1024;
+}
+
+/*
+ * resets the peak resident set size, where the kernel allows it, after
+ * handing free memory back so that reusing it counts.
+ */
+inline bool fib_reset_peak_rss()
+{
+#ifdef __GLIBC__
+  ::malloc_trim(0);
+#endif
+  std::FILE *f = std::fopen("/proc/self/clear_refs", "w");
+  if (!f)
+    return false;
+  bool ok = std::fputs("5", f) >= 0;
+  if (std::fclose(f) != 0)
+    ok = false;
+  return ok;
+}
+
+/*
+ * runs ops on a fresh Adapter twice: once for throughput and peak memory,
+ * once timing every operation. On a pop whose top is not the one the trace
+ * popped but has the same key, a tie the recorded heap broke otherwise, the
+ * two elements swap trace ids so that later operations reach the one still in
+ * the heap. A top of another key is counted in mismatches and keeps its id:
+ * the heaps disagree, and the replay stops at the first operation on it.
+ */
+template<class Adapter, class T>
+fib_replay_stats fib_replay(const std::vector<fib_trace_op<T>> &ops)
+{
+  typedef std::chrono::steady_clock clock;
+  typedef typename Adapter::handle handle;
+
+  fib_replay_stats s;
+  std::memset(&s, 0, sizeof(s));
+  std::size_t counts[4] = { 0, 0, 0, 0 };
+  for (const fib_trace_op<T> &op : ops)
+    counts[op.kind]++;
+  // filled before the memory baseline, so that only the heap counts.
+  std::vector<handle> table; // by trace id.
+  std::vector<uint64_t> trace_of; // by push id, the trace id it stands for.
+  std::vector<uint32_t> ns[4];
+
+  for (int pass = 0; pass < 2; pass++)
+    {
+      bool timed = pass == 1;
+      if (timed)
+	for (int k = 0; k < 4; k++)
+	  ns[k].reserve(counts[k]);
+      table.assign(counts[fib_trace_push], handle());
+      trace_of.assign(counts[fib_trace_push], 0);
+      bool peak = !timed && fib_reset_peak_rss();
+      std::size_t rss = peak ? fib_proc_status_bytes("VmRSS") : 0;
+      uint64_t done = 0, pushed = 0, mismatches = 0;
+      {
+	Adapter a;
+	clock::time_point start = clock::now(), t0 = start;
+	for (const fib_trace_op<T> &op : ops)
+	  {
+	    if (timed)
+	      t0 = clock::now();
+	    if (op.kind == fib_trace_push && op.id == pushed)
+	      {
+		table[op.id] = a.push(op.key, op.id);
+		trace_of[op.id] = op.id;
+		pushed++;
+	      }
+	    else if (op.kind == fib_trace_push || op.id >= pushed || table[op.id] == handle())
+	      {
+		std::cerr << "[Error]: trace replay diverged at operation " << done << std::endl;
+		break;
+	      }
+	    else if (op.kind == fib_trace_pop)
+	      {
+		uint64_t t = trace_of[a.top_id()];
+		if (t == op.id || a.tied(table[op.id], table[t]))
+		  {
+		    handle x = table[op.id];
+		    a.pop();
+		    if (t != op.id)
+		      {
+			table[t] = x;
+			trace_of[a.id(x)] = t;
+		      }
+		    table[op.id] = handle();
+		  }
+		else
+		  {
+		    a.pop();
+		    table[t] = handle();
+		    mismatches++;
+		  }
+	      }
+	    else if (op.kind == fib_trace_decrease_key)
+	      a.decrease_key(table[op.id], op.key);
+	    else
+	      {
+		a.remove(table[op.id]);
+		table[op.id] = handle();
+	      }
+	    if (timed)
+	      ns[op.kind].push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count()));
+	    done++;
+	  }
+	if (!timed)
+	  {
+	    s.seconds = std::chrono::duration<double>(clock::now() - start).count();
+	    s.ops = done;
+	    s.mismatches = mismatches;
+	    s.ops_per_second = s.seconds > 0 ? done / s.seconds : 0;
+	    std::size_t hwm = peak ? fib_proc_status_bytes("VmHWM") : 0;
+	    s.peak_memory = hwm > rss ? hwm - rss : 0;
+	  }
+      }
+    }
+
+  for (int k = 0; k < 4; k++)
+    {
+      std::vector<uint32_t> &v = ns[k];
+      fib_replay_latency &l = s.latency[k];
+      l.count = v.size();
+      if (v.empty())
+	continue;
+      std::sort(v.begin(), v.end());
+      l.p50 = v[v.size() / 2];
+      l.p90 = v[v.size() * 9 / 10];
+      l.p99 = v[v.size() * 99 / 100];
+      l.p999 = v[v.size() * 999 / 1000];
+      l.max = v.back();
+    }
+  return s;
+}
+
+#endif
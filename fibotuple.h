@@ -0,0 +1,327 @@
+/**
+ * Fibonacci Heap composite keys
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Lexicographic priorities made of several fields, as std::tuple or as
+ * named tuples from named_tuple.h:
+ *
+ *   inline auto job(int64_t deadline, uint8_t tenant, uint32_t seq) {
+ *     return named_tuple::make_named_tuple(NAMED_TUPLE_MEMBER(deadline, deadline),
+ *       NAMED_TUPLE_MEMBER(tenant, tenant), NAMED_TUPLE_MEMBER(seq, seq));
+ *   }
+ *   FibTupleHeap<decltype(job(0, 0, 0))> h;
+ *   h.push(job(100, 1, 7));
+ *   int64_t d = h.top().key().deadline();
+ *
+ * When every field is an integer or an enum and they fit in 64 bits, or 128
+ * with __int128, the key is packed at push time into one order-preserving
+ * word, most significant field first, so that every comparison in insert,
+ * consolidate and decrease_key is a single integer compare. The fields are
+ * unpacked on reads. Other keys are compared field by field. Needs C++14.
+ */
+
+#ifndef FIBOTUPLE_H
+#define FIBOTUPLE_H
+
+#include "fiboheap.h"
+#include "fiboqueue.h"
+#include "named_tuple.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * the std::tuple a key is, or derives from as named tuples do.
+ */
+template<class... Ts>
+std::tuple<Ts...> fib_tuple_base(const std::tuple<Ts...>&);
+
+template<class Key>
+using fib_tuple_of = decltype(fib_tuple_base(std::declval<Key>()));
+
+/*
+ * lexicographic order over fields I and up, unrolled at compile time.
+ */
+template<class Key, std::size_t I = 0, std::size_t N = std::tuple_size<fib_tuple_of<Key>>::value>
+struct fib_tuple_order
+{
+  static bool less(const Key &x, const Key &y)
+  {
+    if (std::get<I>(x) < std::get<I>(y))
+      return true;
+    if (std::get<I>(y) < std::get<I>(x))
+      return false;
+    return fib_tuple_order<Key, I + 1, N>::less(x, y);
+  }
+};
+
+template<class Key, std::size_t N>
+struct fib_tuple_order<Key, N, N>
+{
+  static bool less(const Key&, const Key&)
+  {
+    return false;
+  }
+};
+
+template<class Key>
+struct fib_tuple_less
+{
+  bool operator()(const Key &x, const Key &y) const
+  {
+    return fib_tuple_order<Key>::less(x, y);
+  }
+};
+
+template<class Key>
+struct fib_tuple_greater
+{
+  bool operator()(const Key &x, const Key &y) const
+  {
+    return fib_tuple_order<Key>::less(y, x);
+  }
+};
+
+/*
+ * the unsigned integer a field packs into, void if it does not.
+ */
+template<class F, class Enable = void>
+struct fib_field_bits
+{
+  typedef void type;
+  static const bool is_signed = false;
+};
+
+template<class F>
+struct fib_field_bits<F, typename std::enable_if<std::is_integral<F>::value
+						  && !std::is_same<F, bool>::value>::type>
+{
+  typedef typename std::make_unsigned<F>::type type;
+  static const bool is_signed = std::is_signed<F>::value;
+};
+
+template<class F>
+struct fib_field_bits<F, typename std::enable_if<std::is_enum<F>::value>::type>
+{
+  typedef typename std::make_unsigned<typename std::underlying_type<F>::type>::type type;
+  static const bool is_signed = std::is_signed<typename std::underlying_type<F>::type>::value;
+};
+
+template<class Tuple>
+struct fib_tuple_width;
+
+template<>
+struct fib_tuple_width<std::tuple<>>
+{
+  static const bool packable = true;
+  static const std::size_t bits = 0;
+};
+
+template<class F, class... Fs>
+struct fib_tuple_width<std::tuple<F, Fs...>>
+{
+  static const bool packable = !std::is_void<typename fib_field_bits<F>::type>::value
+    && fib_tuple_width<std::tuple<Fs...>>::packable;
+  static const std::size_t bits = 8 * sizeof(F) + fib_tuple_width<std::tuple<Fs...>>::bits;
+};
+
+/*
+ * packer<Key>::word is the packed type, void when the key does not pack.
+ */
+template<class Key>
+struct fib_tuple_packer
+{
+  typedef fib_tuple_width<fib_tuple_of<Key>> width;
+  static const bool packable = width::packable && width::bits > 0;
+#ifdef __SIZEOF_INT128__
+  typedef typename std::conditional<!packable || (width::bits > 128), void,
+    typename std::conditional<(width::bits <= 64), uint64_t, unsigned __int128>::type>::type word;
+#else
+  typedef typename std::conditional<packable && (width::bits <= 64), uint64_t, void>::type word;
+#endif
+  static const bool enabled = !std::is_void<word>::value;
+};
+
+/*
+ * packs fields I and up below w, and unpacks them from the low bits of w.
+ * Signed fields have their sign bit flipped, so that unsigned order matches.
+ * Shifts are split in two halves, as a 64-bit first field shifts a 64-bit
+ * word by its full width.
+ */
+template<class Key, class Word, std::size_t I = 0, std::size_t N = std::tuple_size<fib_tuple_of<Key>>::value>
+struct fib_tuple_fields
+{
+  typedef typename std::tuple_element<I, fib_tuple_of<Key>>::type F;
+  typedef typename fib_field_bits<F>::type U;
+  typedef fib_tuple_fields<Key, Word, I + 1, N> next;
+  static const std::size_t bits = 8 * sizeof(U) + next::bits; // of fields I and up.
+  static const U sign = fib_field_bits<F>::is_signed ? static_cast<U>(U(1) << (8 * sizeof(U) - 1)) : U(0);
+
+  static Word pack(const Key &k, Word w)
+  {
+    U u = static_cast<U>(static_cast<U>(std::get<I>(k)) ^ sign);
+    w = ((w << (4 * sizeof(U))) << (4 * sizeof(U))) | Word(u);
+    return next::pack(k, w);
+  }
+
+  static void unpack(Key &k, Word w)
+  {
+    std::get<I>(k) = static_cast<F>(static_cast<U>(static_cast<U>(w >> next::bits) ^ sign));
+    next::unpack(k, w);
+  }
+};
+
+template<class Key, class Word, std::size_t N>
+struct fib_tuple_fields<Key, Word, N, N>
+{
+  static const std::size_t bits = 0;
+
+  static Word pack(const Key&, Word w)
+  {
+    return w;
+  }
+
+  static void unpack(Key&, Word)
+  {
+  }
+};
+
+/*
+ * a composite key stored as its packed word.
+ */
+template<class Key>
+struct fib_packed_key
+{
+  typedef typename fib_tuple_packer<Key>::word word;
+  static_assert(fib_tuple_packer<Key>::enabled, "packed keys need integer or enum fields fitting in a word");
+
+  fib_packed_key()
+    :packed(0)
+  {
+  }
+
+  fib_packed_key(const Key &k)
+    :packed(fib_tuple_fields<Key, word>::pack(k, word(0)))
+  {
+  }
+
+  Key key() const
+  {
+    Key k;
+    fib_tuple_fields<Key, word>::unpack(k, packed);
+    return k;
+  }
+
+  operator Key() const
+  {
+    return key();
+  }
+
+  bool operator==(const fib_packed_key &o) const
+  {
+    return packed == o.packed;
+  }
+
+  word packed;
+};
+
+template<class Key>
+struct fib_packed_less
+{
+  bool operator()(const fib_packed_key<Key> &x, const fib_packed_key<Key> &y) const
+  {
+    return x.packed < y.packed;
+  }
+};
+
+template<class Key>
+struct fib_packed_greater
+{
+  bool operator()(const fib_packed_key<Key> &x, const fib_packed_key<Key> &y) const
+  {
+    return x.packed > y.packed;
+  }
+};
+
+template<class Key, std::size_t I = 0, std::size_t N = std::tuple_size<fib_tuple_of<Key>>::value>
+struct fib_tuple_printer
+{
+  static void print(std::ostream &os, const Key &k)
+  {
+    // widened, so that 8-bit fields print as numbers.
+    os << (I ? ", " : "(") << +std::get<I>(k);
+    fib_tuple_printer<Key, I + 1, N>::print(os, k);
+  }
+};
+
+template<class Key, std::size_t N>
+struct fib_tuple_printer<Key, N, N>
+{
+  static void print(std::ostream &os, const Key&)
+  {
+    os << ")";
+  }
+};
+
+template<class Key>
+std::ostream& operator<<(std::ostream &os, const fib_packed_key<Key> &k)
+{
+  fib_tuple_printer<Key>::print(os, k.key());
+  return os;
+}
+
+namespace std
+{
+  template<class Key>
+  struct hash<fib_packed_key<Key>>
+  {
+    size_t operator()(const fib_packed_key<Key> &k) const
+    {
+      // folds the high half of a 128-bit word in, a no-op on 64 bits.
+      return hash<uint64_t>()(static_cast<uint64_t>(k.packed) ^ static_cast<uint64_t>((k.packed >> 32) >> 32));
+    }
+  };
+}
+
+/*
+ * FibTupleHeap<Key> packs Key when it can and compares fields otherwise;
+ * FibTupleQueue<Key> needs a packed key, which it hashes.
+ */
+template<class Key, bool Packed = fib_tuple_packer<Key>::enabled>
+struct fib_tuple_heap
+{
+  typedef FibHeap<fib_packed_key<Key>, fib_packed_less<Key>> type;
+};
+
+template<class Key>
+struct fib_tuple_heap<Key, false>
+{
+  typedef FibHeap<Key, fib_tuple_less<Key>> type;
+};
+
+template<class Key>
+using FibTupleHeap = typename fib_tuple_heap<Key>::type;
+
+template<class Key>
+using FibTupleQueue = FibQueue<fib_packed_key<Key>, fib_packed_less<Key>>;
+
+#endif
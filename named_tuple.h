@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <tuple>
 #include <utility>
 
@@ -22,23 +23,23 @@ namespace named_tuple {
 		template <typename T>
 		struct wrap { using type = T; };
 
-		template <typename Base, size_t index, typename... Names>
+		template <typename Base, std::size_t index, typename... Names>
 		struct named_tuple;
 
-		template <typename Base, size_t ignored>
+		template <typename Base, std::size_t ignored>
 		struct named_tuple<Base, ignored> : public Base { using Base::Base; };
 
-		template <typename Base, size_t index, typename Name, typename... Rest>
+		template <typename Base, std::size_t index, typename Name, typename... Rest>
 		struct named_tuple<Base, index, Name, Rest...> : decltype(
 			std::declval<Name>()(
 				wrap<named_tuple<Base, index + 1, Rest...>>{},
-				std::integral_constant<size_t, index>{}
+				std::integral_constant<std::size_t, index>{}
 			)
 		) {
 			using _base = decltype(
 				std::declval<Name>()(
 					wrap<named_tuple<Base, index + 1, Rest...>>{},
-					std::integral_constant<size_t, index>{}
+					std::integral_constant<std::size_t, index>{}
 				)
 			);
 			using _base::_base;
@@ -16,14 +16,58 @@
  */
 
 #include "fiboheap.hpp"
+#include "fiboadaptive.h"
 #include "fiboqueue.hpp"
+#include "fiboprefix.h"
+#include "fibosnapshot.h"
+#include "fibotimer.h"
+#include "fibomerge.h"
+#include "fiboexternal.h"
+#include "fibograph.h"
+#include "fiboidqueue.h"
+#include "fibohugepage.h"
+#include "fiboparallel.h"
+#include "fibopersistent.h"
+#include "fibosoft.h"
+#include "fibotrace.h"
+#include "fibotuple.h"
+#ifdef __cpp_impl_coroutine
+#include "fibocoro.h"
+#endif
 
 #include <stdlib.h>
 #include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
 #include <queue>
+#include <set>
+#include <stdexcept>
+#include <string>
 
 using namespace std;
 
+// every allocation of the program, to check the paths that claim to make none.
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+	allocations++;
+	if(void* p = malloc(size ? size : 1))
+		return p;
+	throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
 void fill_heaps(fibonacci_heap::fibonacci_heap<int>& fh, priority_queue<int, vector<int>, greater<int>>& pqueue, const unsigned int& n) {
 	cout << "fill heaps begin" << endl;
 	for(unsigned int i = 0; i < n; ++i) {
@@ -75,6 +119,1005 @@ bool match_queues(fibonacci_heap::fibonacci_queue::fibonacci_queue<int>& fh, pri
 	return true;
 }
 
+void test_prefix_heap(const unsigned int& n) {
+	cout << "prefix heap begin" << endl;
+	FibPrefixQueue<string> fq;
+	priority_queue<string, vector<string>, greater<string>> pqueue;
+	for(unsigned int i = 0; i < n; ++i) {
+		// shared 8-byte prefixes force the fallback to the full comparison.
+		string s = (i % 2 ? "deadline" : "tenant") + to_string(rand() % 100);
+		fq.push(s);
+		pqueue.push(s);
+	}
+	while(!pqueue.empty()) {
+		assert(fq.top().key == pqueue.top());
+		pqueue.pop();
+		fq.pop();
+	}
+	assert(fq.empty());
+	cout << "prefix heap end" << endl;
+}
+
+void test_snapshot(const unsigned int& n) {
+	cout << "snapshot begin" << endl;
+	FibQueue<int> fq, restored;
+	priority_queue<int, vector<int>, greater<int>> pqueue;
+	for(unsigned int i = 0; i < n; ++i) {
+		int r = rand();
+		fq.push(r, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+		pqueue.push(r);
+	}
+	fq.pop();
+	pqueue.pop();
+	assert(fib_save(fq, "test_snapshot.bin"));
+	assert(fib_load(restored, "test_snapshot.bin"));
+	// corrupted links are rejected and leave the heap loaded into alone.
+	ifstream in("test_snapshot.bin", ios::binary);
+	string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+	typedef fib_snapshot_record<int> Record;
+	size_t records = sizeof(fib_snapshot_header), last = records + (n - 2) * sizeof(Record);
+	auto check_corrupt = [&bytes](size_t at, const void* value, size_t len) {
+		string bad = bytes;
+		memcpy(&bad[at], value, len);
+		ofstream("test_snapshot_bad.bin", ios::binary).write(bad.data(), bad.size());
+		FibHeap<int> h;
+		h.push(-1);
+		assert(!fib_load(h, "test_snapshot_bad.bin"));
+		assert(h.size() == 1 && h.top() == -1);
+		remove("test_snapshot_bad.bin");
+	};
+	uint64_t out_of_range = n + 5, root = 0;
+	int32_t degree = restored.topNode()->degree + 1;
+	check_corrupt(records + offsetof(Record, right), &out_of_range, sizeof(out_of_range));
+	check_corrupt(last + offsetof(Record, child), &root, sizeof(root));
+	check_corrupt(records + offsetof(Record, degree), &degree, sizeof(degree));
+	remove("test_snapshot.bin");
+	assert(restored.size() == pqueue.size());
+	assert(restored.count(pqueue.top()));
+	while(!pqueue.empty()) {
+		assert(restored.top() == pqueue.top());
+		assert(restored.topNode()->payload == fq.topNode()->payload);
+		pqueue.pop();
+		restored.pop();
+		fq.pop();
+	}
+	assert(restored.empty() && restored.fstore.empty());
+	cout << "snapshot end" << endl;
+}
+
+void test_timer_queue() {
+	cout << "timer queue begin" << endl;
+	typedef FibTimerQueue<> Timers;
+	Timers tq;
+	vector<int> fired;
+	Timers::time_point t0;
+	vector<Timers::Timer*> timers;
+	for(int i = 0; i < 10; ++i)
+		timers.push_back(tq.schedule(t0 + chrono::seconds(i), [&fired, i]() { fired.push_back(i); }));
+	tq.reschedule(timers[0], t0 + chrono::seconds(20)); // postpone
+	tq.reschedule(timers[9], t0 - chrono::seconds(1)); // advance
+	tq.cancel(timers[5]);
+	assert(tq.size() == 9);
+	assert(tq.next_deadline() == t0 - chrono::seconds(1));
+	assert(tq.expire_until(t0 + chrono::seconds(4)) == 5);
+	assert((fired == vector<int>{9, 1, 2, 3, 4}));
+	assert(tq.expire_until(t0 + chrono::seconds(30)) == 4);
+	assert((fired == vector<int>{9, 1, 2, 3, 4, 6, 7, 8, 0}));
+	assert(tq.empty());
+	// the callback lives in the node: arming a timer is one allocation.
+	size_t before = allocations;
+	Timers::Timer* t = tq.schedule(t0, [&fired]() { fired.push_back(-2); });
+	assert(allocations == before + 1);
+	tq.cancel(t);
+	tq.schedule(t0, [&fired]() { fired.push_back(-2); });
+	tq.clear();
+	assert(tq.empty() && fired.back() == 0);
+#ifdef __linux__
+	FibTimerFd<> tfd(tq);
+	assert(tfd.fd() >= 0);
+	tq.schedule(chrono::steady_clock::now(), [&fired]() { fired.push_back(-1); });
+	assert(tfd.arm());
+	assert(tfd.dispatch() == 1 && fired.back() == -1);
+#endif
+	cout << "timer queue end" << endl;
+}
+
+void test_update_key(const unsigned int& n) {
+	cout << "update key begin" << endl;
+	FibQueue<int> fq;
+	multiset<int> keys;
+	vector<FibQueue<int>::Node*> nodes;
+	for(unsigned int i = 0; i < n; ++i) {
+		int r = rand() % 1000;
+		nodes.push_back(fq.push(r));
+		keys.insert(r);
+	}
+	nodes.erase(find(nodes.begin(), nodes.end(), fq.topNode()));
+	keys.erase(keys.begin());
+	fq.pop(); // consolidate into trees so that updates cut and promote children.
+	for(auto x : nodes) {
+		int k = x->key + (rand() % 1000) - 500;
+		keys.erase(keys.find(x->key));
+		keys.insert(k);
+		fq.update_key(x, k);
+		assert(fq.top() == *keys.begin());
+	}
+	for(int k : keys) {
+		assert(fq.top() == k);
+		fq.pop();
+	}
+	assert(fq.empty() && fq.fstore.empty());
+	cout << "update key end" << endl;
+}
+
+void test_kway_merge(const unsigned int& n) {
+	cout << "kway merge begin" << endl;
+	vector<vector<int>> runs(n);
+	vector<int> all;
+	for(auto& run : runs) {
+		run.resize(rand() % 50);
+		for(auto& v : run)
+			v = rand() % 1000;
+		sort(run.begin(), run.end());
+		all.insert(all.end(), run.begin(), run.end());
+	}
+	sort(all.begin(), all.end());
+	vector<pair<vector<int>::const_iterator, vector<int>::const_iterator>> ranges;
+	for(const auto& run : runs)
+		ranges.push_back({ run.begin(), run.end() });
+	vector<int> merged;
+	merged.reserve(all.size());
+	auto first = kway_merge(ranges);
+	merged.push_back(*first.begin());
+	++first.begin();
+	// a moved merge carries on where it was.
+	FibMerge<vector<int>::const_iterator> merge(std::move(first));
+	assert(first.empty());
+	auto it = merge.begin();
+	// once started, the merge only moves nodes around.
+	size_t before = allocations;
+	for(; it != merge.end(); ++it)
+		merged.push_back(*it);
+	assert(allocations == before);
+	assert(merged == all);
+	cout << "kway merge end" << endl;
+}
+
+void test_external_heap(const unsigned int& n) {
+	cout << "external heap begin" << endl;
+	// room for a few dozen nodes and blocks of 16 keys, so that runs spill and compact.
+	FibExternalHeap<int> eh(4096, 64, ".");
+	priority_queue<int, vector<int>, greater<int>> pqueue;
+	for(unsigned int i = 0; i < n; ++i) {
+		int r = rand();
+		eh.push(r);
+		pqueue.push(r);
+		if(i % 3 == 0) {
+			assert(eh.top() == pqueue.top());
+			eh.pop();
+			pqueue.pop();
+		}
+	}
+	assert(eh.size() == pqueue.size());
+	while(!pqueue.empty()) {
+		assert(eh.top() == pqueue.top());
+		eh.pop();
+		pqueue.pop();
+	}
+	assert(eh.empty());
+	// runs of 64 keys are merged 8 at a time and level by level, so that
+	// each key is rewritten a logarithmic number of times.
+	FibExternalHeap<int> levels(4096, 256, ".");
+	for(unsigned int i = 0; i < n; ++i) {
+		levels.push(rand());
+		// a spill writes the larger half only, the rest stays in memory.
+		if(levels.run_count() == 1 && levels.written() == levels.size() - levels.memory_size())
+			assert(levels.memory_size() > 0 && levels.memory_size() + 1 >= levels.written());
+	}
+	assert(levels.written() <= 4 * n && levels.run_count() < 4 * 8);
+	int last = numeric_limits<int>::min();
+	while(!levels.empty()) {
+		assert(levels.top() >= last);
+		last = levels.top();
+		levels.pop();
+	}
+	cout << "external heap end" << endl;
+}
+
+void test_graph(const unsigned int& n) {
+	cout << "graph begin" << endl;
+	vector<FibCsrGraph<long>::Edge> edges;
+	for(unsigned int i = 0; i < 4 * n; ++i)
+		edges.push_back(FibCsrGraph<long>::Edge(rand() % n, rand() % n, rand() % 100));
+	// reference Dijkstra and Prim, with lazy deletion.
+	typedef pair<long, uint32_t> item;
+	auto g = FibCsrGraph<long>::from_edges(n, edges);
+	auto rg = g.reversed();
+	vector<long> dist(n, numeric_limits<long>::max());
+	priority_queue<item, vector<item>, greater<item>> pq;
+	dist[0] = 0;
+	pq.push(item(0, 0));
+	while(!pq.empty()) {
+		item it = pq.top();
+		pq.pop();
+		if(it.first > dist[it.second])
+			continue;
+		for(size_t i = g.offsets[it.second]; i < g.offsets[it.second + 1]; ++i)
+			if(it.first + g.weights[i] < dist[g.targets[i]]) {
+				dist[g.targets[i]] = it.first + g.weights[i];
+				pq.push(item(dist[g.targets[i]], g.targets[i]));
+			}
+	}
+	for(uint32_t t = 0; t < n; ++t) {
+		vector<uint32_t> path;
+		long d = fib_bidirectional_dijkstra(g, rg, 0, t, &path);
+		assert(d == dist[t]);
+		if(d != numeric_limits<long>::max()) {
+			assert(path.front() == 0 && path.back() == t);
+			long len = 0;
+			for(size_t j = 1; j < path.size(); ++j) {
+				long w = numeric_limits<long>::max();
+				for(size_t i = g.offsets[path[j - 1]]; i < g.offsets[path[j - 1] + 1]; ++i)
+					if(g.targets[i] == path[j])
+						w = min(w, g.weights[i]);
+				len += w;
+			}
+			assert(len == d);
+		}
+	}
+	auto ug = FibCsrGraph<long>::from_edges(n, edges, true);
+	vector<char> done(n, 0);
+	long total = 0;
+	for(uint32_t root = 0; root < n; ++root) {
+		if(done[root])
+			continue;
+		pq.push(item(0, root));
+		while(!pq.empty()) {
+			item it = pq.top();
+			pq.pop();
+			if(done[it.second])
+				continue;
+			done[it.second] = 1;
+			total += it.first;
+			for(size_t i = ug.offsets[it.second]; i < ug.offsets[it.second + 1]; ++i)
+				if(!done[ug.targets[i]])
+					pq.push(item(ug.weights[i], ug.targets[i]));
+		}
+	}
+	vector<uint32_t> parent;
+	assert(fib_prim_mst(ug, parent) == total);
+	cout << "graph end" << endl;
+}
+
+void test_stable_heap(const unsigned int& n) {
+	cout << "stable heap begin" << endl;
+	FibHeap<int, less<int>, true> fh;
+	for(unsigned int i = 0; i < n; ++i)
+		fh.push(rand() % 10, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+	int last_key = -1;
+	uintptr_t last_order = 0;
+	while(!fh.empty()) {
+		uintptr_t order = reinterpret_cast<uintptr_t>(fh.topNode()->payload);
+		assert(fh.top() >= last_key);
+		assert(fh.top() > last_key || order > last_order);
+		last_key = fh.top();
+		last_order = order;
+		fh.pop();
+	}
+	cout << "stable heap end" << endl;
+}
+
+void test_typed_heap(const unsigned int& n) {
+	cout << "typed heap begin" << endl;
+	TypedFibQueue<int, string> fq;
+	for(unsigned int i = 0; i < n; ++i)
+		fq.emplace(i, 3, 'a' + i % 26);
+	fq.push(-1, "first");
+	assert(fq.top_value() == "first");
+	fq.pop();
+	fq.update_key(fq.findNode(n - 1), -1);
+	assert(fq.top_value() == string(3, 'a' + (n - 1) % 26));
+	fq.pop();
+	for(unsigned int i = 0; i + 1 < n; ++i) {
+		assert(fq.top() == static_cast<int>(i));
+		assert(fq.top_value() == string(3, 'a' + i % 26));
+		fq.pop();
+	}
+	assert(fq.empty());
+	static_assert(sizeof(FibHeap<int, less<int>, false, void>::FibNode) < sizeof(FibHeap<int>::FibNode), "void payload takes no space");
+	FibHeap<int, less<int>, false, void> bare;
+	bare.push(1);
+	bare.emplace(0);
+	assert(bare.top() == 0);
+	cout << "typed heap end" << endl;
+}
+
+void test_id_queue(const unsigned int& n) {
+	cout << "id queue begin" << endl;
+	FibIdQueue<string, int> fq;
+	map<string, int> ref;
+	for(unsigned int i = 0; i < 20 * n; ++i) {
+		string id = "job-" + to_string(rand() % n);
+		int k = rand() % 1000;
+		switch(rand() % 4) {
+		case 0:
+			assert((fq.push(id, k) != nullptr) == (ref.count(id) == 0));
+			ref.insert(make_pair(id, k));
+			break;
+		case 1:
+			assert(fq.update_key(id, k) == (ref.count(id) == 1));
+			if(ref.count(id))
+				ref[id] = k;
+			break;
+		case 2:
+			assert(fq.remove(id) == (ref.erase(id) == 1));
+			break;
+		default:
+			if(fq.empty())
+				break;
+			assert(ref[fq.top_id()] == fq.top());
+			ref.erase(fq.top_id());
+			fq.pop();
+		}
+		assert(fq.size() == ref.size() && fq.ids.size() == ref.size());
+	}
+	for(auto& e : ref)
+		assert(fq.find(e.first) && fq.find(e.first)->key == e.second);
+	int last = -1;
+	while(!fq.empty()) {
+		assert(fq.top() >= last);
+		last = fq.top();
+		fq.pop();
+	}
+	assert(fq.ids.size() == 0);
+	cout << "id queue end" << endl;
+}
+
+void test_hugepage_heap(const unsigned int& n) {
+	cout << "hugepage heap begin" << endl;
+	FibHugePageQueue<int> fq;
+	multiset<int> ref;
+	vector<FibHugePageQueue<int>::Node*> nodes;
+	for(unsigned int i = 0; i < 20 * n; ++i) {
+		int k = rand() % 1000;
+		if(rand() % 3 || fq.empty()) {
+			nodes.push_back(fq.push(k));
+			ref.insert(k);
+		} else if(rand() % 2) {
+			size_t j = rand() % nodes.size();
+			ref.erase(ref.find(nodes[j]->key));
+			fq.remove_fibnode(nodes[j]);
+			nodes[j] = nodes.back();
+			nodes.pop_back();
+		} else {
+			assert(fq.top() == *ref.begin());
+			FibHugePageQueue<int>::Node* x = fq.topNode();
+			nodes.erase(find(nodes.begin(), nodes.end(), x));
+			ref.erase(ref.begin());
+			fq.pop();
+		}
+	}
+	// freed slots are reused before new slabs are mapped.
+	assert(fq.node_alloc().arena->slab_count() <= 1 + 20 * n * sizeof(FibHugePageQueue<int>::Node) / fib_hugepage_arena::slab_size);
+	for(int k : ref) {
+		assert(fq.top() == k);
+		fq.pop();
+	}
+	assert(fq.empty());
+	cout << "hugepage heap end" << endl;
+}
+
+void test_parallel_consolidate(const unsigned int& n) {
+	cout << "parallel consolidate begin" << endl;
+	FibParallelHeap<int> threads;
+	threads.set_parallel_consolidate(1, 4);
+	multiset<int> ref;
+	for(unsigned int i = 0; i < n; ++i) {
+		int k = rand() % 1000;
+		threads.push(k);
+		ref.insert(k);
+	}
+	for(int k : ref) {
+		assert(threads.top() == k);
+		threads.pop();
+	}
+	assert(threads.empty());
+	// tasks run in reverse order on this thread.
+	FibParallelHeap<int, less<int>, true> stable;
+	stable.set_parallel_consolidate(1, 3, [](size_t tasks, const function<void(size_t)>& task) {
+			for(size_t t = tasks; t-- > 0; )
+				task(t);
+		});
+	for(unsigned int i = 0; i < n; ++i)
+		stable.push(rand() % 10, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+	int last_key = -1;
+	uintptr_t last_order = 0;
+	while(!stable.empty()) {
+		uintptr_t order = reinterpret_cast<uintptr_t>(stable.topNode()->payload);
+		assert(stable.top() > last_key || (stable.top() == last_key && order > last_order));
+		last_key = stable.top();
+		last_order = order;
+		stable.pop();
+	}
+	cout << "parallel consolidate end" << endl;
+}
+
+void test_ordered_iteration(const unsigned int& n) {
+	cout << "ordered iteration begin" << endl;
+	FibHeap<int> fh;
+	vector<FibHeap<int>::FibNode*> nodes;
+	for(unsigned int i = 0; i < n; ++i)
+		nodes.push_back(fh.push(rand() % 1000));
+	// build trees and marks, so that the walk goes below the roots.
+	fh.decrease_key(nodes[n / 2], -1);
+	fh.pop();
+	nodes.erase(nodes.begin() + n / 2);
+	for(unsigned int i = 0; i < n / 10; ++i) {
+		FibHeap<int>::FibNode* x = nodes[rand() % nodes.size()];
+		fh.decrease_key(x, x->key - rand() % 100);
+	}
+	multiset<int> ref;
+	fh.for_each_node([&ref](FibHeap<int>::FibNode* x) { ref.insert(x->key); });
+	assert(ref.size() == fh.size());
+	assert(equal(ref.begin(), ref.end(), fh.ordered_begin()));
+	vector<FibHeap<int>::FibNode*> first = fh.peek_n(10);
+	assert(first.size() == 10 && first[0] == fh.topNode());
+	for(size_t i = 0; i < first.size(); ++i)
+		assert(first[i]->key == *next(ref.begin(), i));
+	assert(fh.peek_n(2 * n).size() == ref.size());
+	for(int k : ref) {
+		assert(fh.top() == k);
+		fh.pop();
+	}
+	assert(fh.empty() && fh.ordered_begin() == fh.ordered_end() && fh.peek_n(1).empty());
+	cout << "ordered iteration end" << endl;
+}
+
+template<class Heap>
+void check_clone(Heap& fh, unsigned int n) {
+	for(unsigned int i = 0; i < n; ++i)
+		fh.push(rand() % 1000);
+	fh.pop();
+	for(unsigned int i = 0; i < n / 10; ++i)
+		fh.pop();
+	vector<int> before(fh.ordered_begin(), fh.ordered_end());
+	Heap copy = fh.clone();
+	Heap assigned;
+	assigned = copy;
+	assert(vector<int>(copy.ordered_begin(), copy.ordered_end()) == before);
+	// the copies are independent of the original.
+	copy.decrease_key(copy.peek_n(n).back(), -1);
+	for(unsigned int i = 0; i < n / 10; ++i)
+		copy.push(rand() % 1000);
+	while(!copy.empty() && copy.top() < 500)
+		copy.pop();
+	assert(vector<int>(fh.ordered_begin(), fh.ordered_end()) == before);
+	Heap moved(std::move(assigned));
+	assert(assigned.empty() && moved.size() == before.size());
+	for(int k : before) {
+		assert(moved.top() == k);
+		moved.pop();
+	}
+}
+
+void test_clone(const unsigned int& n) {
+	cout << "clone begin" << endl;
+	FibHeap<int> fh;
+	check_clone(fh, n);
+	FibQueue<int> fq;
+	check_clone(fq, n);
+	FibQueue<int> qcopy(fq);
+	assert(qcopy.fstore.size() == fq.size() && qcopy.count(fq.top()) && qcopy.findNode(fq.top()) != fq.findNode(fq.top()));
+	static_assert(is_trivially_copyable<FibHugePageHeap<int>::FibNode>::value, "slab copies need trivially copyable nodes");
+	FibHugePageHeap<int> hh;
+	check_clone(hh, n);
+	FibHugePageHeap<int> hcopy(hh);
+	assert(hcopy.node_alloc().arena != hh.node_alloc().arena && hcopy.topNode() != hh.topNode());
+	// an arena that never carved a slot clones into an empty one.
+	fib_hugepage_arena fresh;
+	fib_hugepage_arena::rebase_map rb;
+	assert(fresh.clone(rb)->slab_count() == 0);
+	FibIdQueue<string, int> iq;
+	for(unsigned int i = 0; i < n; ++i)
+		iq.push(to_string(i), rand() % 1000);
+	FibIdQueue<string, int> icopy = iq.clone();
+	assert(icopy.ids.size() == n && icopy.find("7") != iq.find("7") && icopy.find("7")->key == iq.find("7")->key);
+	cout << "clone end" << endl;
+}
+
+void test_erase_if(const unsigned int& n) {
+	cout << "erase if begin" << endl;
+	// payloads are tenant ids, keys are spread over the trees after a pop and decrease_keys.
+	FibQueue<int> fq;
+	vector<FibQueue<int>::Node*> nodes;
+	for(unsigned int i = 0; i < n; ++i)
+		nodes.push_back(fq.push(rand() % 1000, reinterpret_cast<void*>(uintptr_t(i % 7))));
+	fq.pop();
+	for(unsigned int i = 0; i < n / 10; ++i) {
+		FibQueue<int>::Node* x = nodes[rand() % nodes.size()];
+		if(x != fq.topNode() && x->key > 0)
+			fq.decrease_key(x, x->key - 1);
+	}
+	multiset<int> ref;
+	fq.for_each_node([&ref](FibQueue<int>::Node* x) {
+		if(x->payload != reinterpret_cast<void*>(3))
+			ref.insert(x->key);
+	});
+	size_t erased = fq.erase_if([](FibQueue<int>::Node* x) { return x->payload == reinterpret_cast<void*>(3); });
+	assert(erased + ref.size() == n - 1 && fq.size() == ref.size() && fq.fstore.size() == ref.size());
+	assert(fq.erase_if([](FibQueue<int>::Node* x) { return x->payload == reinterpret_cast<void*>(3); }) == 0);
+	for(int k : ref) {
+		assert(fq.top() == k && fq.topNode()->payload != reinterpret_cast<void*>(3));
+		fq.pop();
+	}
+	FibHeap<int> fh;
+	for(unsigned int i = 0; i < n; ++i)
+		fh.push(i);
+	fh.pop();
+	assert(fh.erase_if([](FibHeap<int>::FibNode*) { return true; }) == n - 1 && fh.empty() && !fh.topNode());
+	FibIdQueue<int, int> iq;
+	for(unsigned int i = 0; i < n; ++i)
+		iq.push(i, rand() % 1000);
+	assert(iq.erase_if([](FibIdQueue<int, int>::Node* x) { return x->payload % 2; }) == n / 2);
+	assert(iq.ids.size() == iq.size() && !iq.contains(1) && iq.contains(2));
+	cout << "erase if end" << endl;
+}
+
+void test_persistent_heap(const unsigned int& n) {
+	cout << "persistent heap begin" << endl;
+	// random versions forked from random earlier ones, each checked against its own multiset.
+	vector<FibPersistentHeap<int>> versions(1);
+	vector<multiset<int>> refs(1);
+	for(unsigned int i = 0; i < n; ++i) {
+		size_t v = rand() % versions.size();
+		FibPersistentHeap<int> h = versions[v];
+		multiset<int> ref = refs[v];
+		int op = rand() % 4;
+		if(op < 2) {
+			int k = rand() % 100;
+			h = h.push(k);
+			ref.insert(k);
+		} else if(op == 2 && !h.empty()) {
+			h = h.pop();
+			ref.erase(ref.begin());
+		} else {
+			size_t w = rand() % versions.size();
+			h = h.merge(versions[w]);
+			ref.insert(refs[w].begin(), refs[w].end());
+		}
+		versions.push_back(h);
+		refs.push_back(ref);
+	}
+	for(size_t v = 0; v < versions.size(); ++v) {
+		assert(versions[v].size() == refs[v].size());
+		FibPersistentHeap<int> h = versions[v];
+		for(int k : refs[v]) {
+			assert(h.top() == k);
+			h = h.pop();
+		}
+		assert(h.empty());
+	}
+	FibPersistentHeap<int> a = FibPersistentHeap<int>().push(2).push(1);
+	FibPersistentHeap<int> b = a;
+	assert(a.use_count() == 2);
+	// a heap on its own pool is copied in on merge.
+	FibPersistentHeap<int> other(less<int>(), make_shared<FibPersistentHeap<int>::pool_type>());
+	FibPersistentHeap<int> c = a.merge(other.push(0).push(5));
+	assert(c.size() == 4 && c.top() == 0 && c.pop().top() == 1 && a.top() == 1 && a.size() == 2);
+	cout << "persistent heap end" << endl;
+}
+
+void test_soft_heap(const unsigned int& n) {
+	cout << "soft heap begin" << endl;
+	for(double eps : { 0.01, 0.2 }) {
+		FibSoftHeap<int> sh(eps);
+		multiset<int> ref;
+		size_t pushes = 0;
+		for(unsigned int i = 0; i < n; ++i) {
+			if(rand() % 3 || sh.empty()) {
+				int k = rand() % 10000;
+				sh.push(k);
+				ref.insert(k);
+				++pushes;
+			} else {
+				assert(!(sh.top_ckey() < sh.top()) && sh.top_corrupted() == (sh.top() < sh.top_ckey()));
+				ref.erase(ref.find(sh.top()));
+				sh.pop();
+			}
+			assert(sh.size() == ref.size());
+			if(i % 100 == 0 && !sh.empty()) {
+				// items whose key was not raised are never ranked before the top.
+				multiset<int> intact = ref;
+				sh.for_each_corrupted([&intact](int k, int ckey) {
+					assert(k < ckey);
+					intact.erase(intact.find(k));
+				});
+				assert(ref.size() - intact.size() == sh.corrupted_count() && sh.corrupted_count() <= eps * pushes);
+				assert(intact.empty() || !(*intact.begin() < sh.top_ckey()));
+			}
+		}
+		while(!sh.empty()) {
+			ref.erase(ref.find(sh.top()));
+			sh.pop();
+		}
+		assert(ref.empty());
+	}
+	cout << "soft heap end" << endl;
+}
+
+void test_adaptive_heap(const unsigned int& n) {
+	cout << "adaptive heap begin" << endl;
+	typedef FibAdaptiveHeap<int> Heap;
+	// decrease_key nearly free on the Fibonacci side, so that decrease phases move there.
+	fib_adaptive_costs costs;
+	costs.dary_decrease = 1000;
+	costs.fib_decrease = 0;
+	Heap h(less<int>(), costs, true);
+	set<Heap::handle> handles;
+	for(unsigned int i = 0; i < n / 2; ++i)
+		handles.insert(h.push(rand() % 100000));
+	for(int phase = 0; phase < 3; ++phase) {
+		for(unsigned int i = 0; i < n; ++i) {
+			if(phase % 2 == 0)
+				handles.insert(h.push(rand() % 100000));
+			if(phase % 2) {
+				for(int d = 0; d < 8; ++d) {
+					Heap::handle x = *next(handles.begin(), rand() % handles.size());
+					h.decrease_key(x, h.key(x) - rand() % 100);
+				}
+			} else {
+				handles.erase(h.top_handle());
+				h.pop();
+			}
+			if(phase == 2 && i == n / 2)
+				h.set_representation(!h.fibonacci());
+		}
+		// a phase is long enough to move back after the forced move.
+		assert(h.fibonacci() == (phase == 1));
+		// the handles survived the moves, and the top is the smallest key.
+		multiset<int> ref;
+		for(Heap::handle x : handles)
+			ref.insert(h.key(x));
+		assert(ref.size() == h.size() && h.top() == *ref.begin() && h.key(h.top_handle()) == h.top());
+	}
+	Heap fixed;
+	fixed.set_representation(true, false);
+	for(unsigned int i = 0; i < n; ++i)
+		fixed.push(n - i);
+	for(unsigned int i = 1; i <= n; ++i) {
+		assert(fixed.fibonacci() && fixed.top() == int(i));
+		fixed.pop();
+	}
+	// clear() frees the entries of the nodes left in the Fibonacci heap.
+	for(unsigned int i = 0; i < n; ++i)
+		fixed.push(i);
+	fixed.clear();
+	assert(fixed.empty() && fixed.fibonacci());
+	cout << "adaptive heap end" << endl;
+}
+
+bool greater_int(int a, int b) {
+	return a > b;
+}
+
+void test_policies(const unsigned int& n) {
+	cout << "policies begin" << endl;
+	// empty policies take no space, the others their fields only.
+	typedef FibHeap<int, less<int>, false, void*, allocator<int>, fib_counting_stats> Heap;
+	// the size and the minimum, with no parallel or handle state.
+	assert(sizeof(FibHeap<int>) <= 2 * sizeof(void*));
+	assert(sizeof(FibHeap<int, less<int>, true>) == sizeof(FibHeap<int>) + sizeof(uint64_t));
+	assert(sizeof(FibHeap<int, bool(*)(int, int)>) == sizeof(FibHeap<int>) + sizeof(void*));
+	assert(sizeof(Heap) == sizeof(FibHeap<int>) + sizeof(fib_counting_stats));
+	Heap h;
+	vector<Heap::FibNode*> nodes;
+	for(unsigned int i = 0; i < n; ++i)
+		nodes.push_back(h.push(rand() % 100000));
+	Heap::FibNode* first = h.topNode();
+	h.pop();
+	const fib_counting_stats& s = h.stats();
+	// the first pop links the n - 1 roots into one tree per bit of n - 1.
+	unsigned int trees = 0;
+	for(unsigned int b = n - 1; b; b >>= 1)
+		trees += b & 1;
+	assert(s.inserts == n && s.extracts == 1 && s.consolidations == 1);
+	assert(s.roots == n - 1 && s.links == n - 1 - trees && s.cuts == 0);
+	uint64_t children = 0;
+	for(unsigned int i = 0; i < n; ++i) {
+		if(nodes[i] == first || !nodes[i]->p)
+			continue;
+		children++;
+		h.decrease_key(nodes[i], -int(i));
+	}
+	assert(s.cuts >= children);
+	int last = numeric_limits<int>::min();
+	while(!h.empty()) {
+		assert(h.top() >= last);
+		last = h.top();
+		h.pop();
+	}
+	assert(s.extracts == n);
+	FibHeap<int, bool(*)(int, int)> g(greater_int);
+	for(unsigned int i = 0; i < n; ++i)
+		g.push(i);
+	assert(g.top() == int(n) - 1);
+	// the handle policy of queues follows the core operations too.
+	FibQueue<int> q;
+	FibQueue<int>::Heap& core = q;
+	for(unsigned int i = 0; i < n; ++i)
+		core.push(rand() % 100);
+	core.update_key(core.topNode(), 1000);
+	core.pop();
+	vector<int> batch;
+	core.pop_n(n / 4, back_inserter(batch));
+	core.erase_if([](FibQueue<int>::Node* x) { return x->key == 50; });
+	assert(q.fstore.size() == q.size() && q.count(1000) && !q.count(50));
+	FibQueue<int>::Heap other(q);
+	unique_ptr<FibQueue<int>::Heap> both(FibQueue<int>::Heap::union_fibheap(&core, &other));
+	assert(both->fstore.size() == 2 * q.size() && both->fstore.count(1000) == 2);
+	// the union owns the nodes now.
+	for(FibQueue<int>::Heap* h : { &core, &other }) {
+		h->min = nullptr;
+		h->n = 0;
+		h->fstore.clear();
+	}
+	// the former API forwards to the core, handles included.
+	fibonacci_heap::fibonacci_queue::fibonacci_queue<int> old;
+	fibonacci_heap::c_node* a = old.create_c_node_on_heap(2, nullptr);
+	old.create_c_node_on_heap(1);
+	old.remove_c_node(old.findNode(1));
+	assert(old.size() == 1 && old.topNode() == a && old.findNode(2) == a);
+	cout << "policies end" << endl;
+}
+
+// pops keys into trace_pops, to compare a replay with the recording.
+vector<int> trace_pops;
+
+struct trace_check_adapter : fib_replay_adapter<FibHeap<int>> {
+	void pop() {
+		trace_pops.push_back(heap.top());
+		heap.pop();
+	}
+};
+
+void test_trace(const unsigned int& n) {
+	cout << "trace begin" << endl;
+	char path[] = "/tmp/fibotrace-XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd >= 0);
+	close(fd);
+	vector<int> pushed, popped;
+	size_t left = 0;
+	{
+		FibTraced<FibHeap<int>> h(path);
+		vector<FibHeap<int>::FibNode*> live;
+		for(unsigned int i = 0; i < n; ++i) {
+			// few distinct keys, so that the replay meets ties.
+			pushed.push_back(rand() % 1000);
+			live.push_back(h.push(pushed.back()));
+		}
+		for(unsigned int i = 0; i < n / 2; ++i) {
+			size_t j = rand() % live.size();
+			if(i % 3 == 0) {
+				h.remove_fibnode(live[j]);
+				live.erase(live.begin() + j);
+			} else
+				h.decrease_key(live[j], live[j]->key - rand() % 50);
+			popped.push_back(h.top());
+			live.erase(find(live.begin(), live.end(), h.topNode()));
+			h.pop();
+		}
+		// a node pushed around the recorder is skipped, not looked up blindly.
+		FibHeap<int>::FibNode* hidden = h.FibHeap<int>::push(-1);
+		h.decrease_key(hidden, -2);
+		h.remove_fibnode(hidden);
+		assert(h.untraced() == 2);
+		// erase_if and clear record a remove per node.
+		left = live.size();
+		size_t erased = h.erase_if([](FibHeap<int>::FibNode* x) { return x->key % 2 == 0; });
+		assert(h.size() == left - erased);
+		h.clear();
+		assert(h.flush_trace());
+	}
+	vector<fib_trace_op<int>> ops;
+	assert(fib_trace_read(path, ops));
+	assert(ops.size() == n + n + left);
+	unsigned int pushes = 0, pops = 0, removes = 0;
+	for(const fib_trace_op<int>& op : ops) {
+		if(op.kind == fib_trace_push) {
+			assert(op.id == pushes && op.key == pushed[pushes]);
+			pushes++;
+		}
+		pops += op.kind == fib_trace_pop;
+		removes += op.kind == fib_trace_remove;
+	}
+	assert(pushes == n && pops == n / 2 && removes == (n / 2 + 2) / 3 + left);
+	// the replay pops the same keys, once per pass.
+	fib_replay_stats s = fib_replay<trace_check_adapter>(ops);
+	assert(s.ops == ops.size() && s.mismatches == 0 && s.ops_per_second > 0);
+	assert(s.latency[fib_trace_pop].count == n / 2 && s.latency[fib_trace_push].p50 <= s.latency[fib_trace_push].max);
+	assert(trace_pops.size() == 2 * popped.size());
+	assert(equal(popped.begin(), popped.end(), trace_pops.begin()));
+	assert(equal(popped.begin(), popped.end(), trace_pops.begin() + popped.size()));
+	s = fib_replay<fib_replay_adapter<FibQueue<int, less<int>, true>>>(ops);
+	assert(s.ops == ops.size() && s.mismatches == 0);
+	// a heap of the other order pops another key: counted, not relabeled.
+	vector<fib_trace_op<int>> order = { { fib_trace_push, 0, 1 }, { fib_trace_push, 1, 2 },
+					    { fib_trace_pop, 0, 0 }, { fib_trace_pop, 1, 0 } };
+	s = fib_replay<fib_replay_adapter<FibHeap<int, greater<int>>>>(order);
+	assert(s.mismatches == 1 && s.ops == 3);
+	// a truncated record is reported, not read past.
+	assert(truncate(path, 20) == 0);
+	assert(!fib_trace_read(path, ops));
+	unlink(path);
+	cout << "trace end" << endl;
+}
+
+inline auto tuple_job(int64_t deadline, uint8_t tenant, uint32_t seq) {
+	return named_tuple::make_named_tuple(NAMED_TUPLE_MEMBER(deadline, deadline), NAMED_TUPLE_MEMBER(tenant, tenant), NAMED_TUPLE_MEMBER(seq, seq));
+}
+
+typedef decltype(tuple_job(0, 0, 0)) tuple_job_t;
+
+void test_tuple_heap(const unsigned int& n) {
+	cout << "tuple heap begin" << endl;
+	typedef tuple<int64_t, uint8_t, uint32_t> Ref;
+	// 104 bits pack into 128, 56 into 64, a double does not pack.
+	static_assert(sizeof(fib_packed_key<tuple_job_t>) == 16, "named tuple packs into 128 bits");
+	static_assert(sizeof(fib_packed_key<tuple<int32_t, uint8_t, uint16_t>>) == 8, "small tuple packs into 64 bits");
+	static_assert(!fib_tuple_packer<tuple<double, int>>::enabled, "doubles are compared field by field");
+	FibTupleHeap<tuple_job_t> h;
+	vector<Ref> ref;
+	vector<FibTupleHeap<tuple_job_t>::FibNode*> nodes;
+	for(unsigned int i = 0; i < n; ++i) {
+		int64_t d = (rand() % 200) - 100;
+		if(i % 7 == 0)
+			d = i % 2 ? numeric_limits<int64_t>::max() - i : numeric_limits<int64_t>::min() + i;
+		uint8_t t = rand() % 256;
+		nodes.push_back(h.push(tuple_job(d, t, i)));
+		ref.push_back(Ref(d, t, i));
+	}
+	// decrease_key on a few keys, by their deadline then by their tenant.
+	for(unsigned int i = 1; i < n; i += 11) {
+		Ref& r = ref[i];
+		if(get<0>(r) == numeric_limits<int64_t>::min() + int64_t(i))
+			continue;
+		get<0>(r) -= 1;
+		get<1>(r) = 0;
+		h.decrease_key(nodes[i], tuple_job(get<0>(r), get<1>(r), get<2>(r)));
+	}
+	sort(ref.begin(), ref.end());
+	for(const Ref& r : ref) {
+		tuple_job_t j = h.top().key();
+		assert(j.deadline() == get<0>(r) && j.tenant() == get<1>(r) && j.seq() == get<2>(r));
+		h.pop();
+	}
+	assert(h.empty());
+	// signed fields order below unsigned ones, and a queue finds packed keys.
+	FibTupleQueue<tuple<int32_t, uint8_t, int16_t>> q;
+	q.push(tuple<int32_t, uint8_t, int16_t>(-1, 255, 7));
+	q.push(tuple<int32_t, uint8_t, int16_t>(-1, 255, -7));
+	q.push(tuple<int32_t, uint8_t, int16_t>(0, 0, -32768));
+	assert(q.findNode(tuple<int32_t, uint8_t, int16_t>(0, 0, -32768)) != NULL);
+	assert(q.top().key() == make_tuple(int32_t(-1), uint8_t(255), int16_t(-7)));
+	FibTupleHeap<tuple<double, int>> g;
+	for(unsigned int i = 0; i < n; ++i)
+		g.push(make_tuple(double(rand() % 10) / 4, int(i)));
+	tuple<double, int> last = g.top();
+	while(!g.empty()) {
+		assert(!(g.top() < last));
+		last = g.top();
+		g.pop();
+	}
+	cout << "tuple heap end" << endl;
+}
+
+// an output iterator that throws after a given number of writes.
+struct failing_output {
+	int* left;
+	failing_output& operator*() { return *this; }
+	failing_output& operator++(int) { return *this; }
+	failing_output& operator=(int) {
+		if((*left)-- == 0)
+			throw runtime_error("output full");
+		return *this;
+	}
+};
+
+void test_pop_n(const unsigned int& n) {
+	cout << "pop n begin" << endl;
+	// batches pop the keys and payloads k pops would, consolidating once.
+	typedef FibHeap<int, less<int>, true, void*, allocator<int>, fib_counting_stats> Heap;
+	Heap h;
+	vector<Heap::FibNode*> nodes;
+	for(unsigned int i = 0; i < n; ++i)
+		nodes.push_back(h.push(rand() % 100, reinterpret_cast<void*>(uintptr_t(i))));
+	Heap::FibNode* first = h.topNode();
+	h.pop();
+	for(unsigned int i = 0; i < n; i += 3)
+		if(nodes[i] != first)
+			h.decrease_key(nodes[i], nodes[i]->key - rand() % 10);
+	Heap ref(h);
+	for(size_t k : { size_t(0), size_t(1), size_t(7), size_t(64), size_t(n) }) {
+		for(unsigned int i = 0; i < k / 2; ++i)
+			ref.push(h.push(rand() % 100, reinterpret_cast<void*>(uintptr_t(n + i)))->key, reinterpret_cast<void*>(uintptr_t(n + i)));
+		size_t size = h.size();
+		uint64_t consolidations = h.stats().consolidations;
+		vector<Heap::FibNode*> batch = h.extract_n(k);
+		assert(batch.size() == min(k, size) && h.size() == size - batch.size());
+		assert(h.stats().consolidations == consolidations + (batch.empty() || h.empty() ? 0 : 1));
+		for(Heap::FibNode* x : batch) {
+			Heap::FibNode* y = ref.extract_min();
+			assert(x->key == y->key && x->payload == y->payload);
+			h.destroy_node(x);
+			ref.destroy_node(y);
+		}
+		if(!h.empty())
+			assert(h.top() == ref.top());
+	}
+	assert(h.size() == ref.size());
+	// queues drop the fast store entries with the nodes.
+	FibQueue<int> fq;
+	vector<int> keys;
+	for(unsigned int i = 0; i < n; ++i) {
+		keys.push_back(rand() % (n / 4 + 1));
+		fq.push(keys.back());
+	}
+	sort(keys.begin(), keys.end());
+	vector<int> popped;
+	while(!fq.empty()) {
+		fq.pop_n(1 + rand() % 100, back_inserter(popped));
+		assert(fq.fstore.size() == fq.size());
+		if(!fq.empty())
+			assert(fq.findNode(fq.top())->key == fq.top());
+	}
+	assert(popped == keys);
+	FibIdQueue<int, int> iq;
+	for(unsigned int i = 0; i < n; ++i)
+		iq.push(int(i), rand() % 1000);
+	popped.clear();
+	iq.pop_n(n / 2, back_inserter(popped));
+	assert(is_sorted(popped.begin(), popped.end()) && iq.size() == n - n / 2 && iq.ids.size() == iq.size());
+	assert(iq.empty() || iq.top() >= popped.back());
+	// a throwing output frees the rest of the batch, which left the heap.
+	FibHeap<int> fh;
+	for(unsigned int i = 0; i < n; ++i)
+		fh.push(rand());
+	int left = 3;
+	bool thrown = false;
+	try {
+		fh.pop_n(10, failing_output { &left });
+	} catch(const runtime_error&) {
+		thrown = true;
+	}
+	assert(thrown && fh.size() == n - 10);
+	cout << "pop n end" << endl;
+}
+
+#ifdef __cpp_impl_coroutine
+FibScheduler<>::task coro_worker(FibScheduler<>& s, int id, int yields, vector<int>& order) {
+	for(int i = 0; i < yields; ++i) {
+		order.push_back(id);
+		co_await s.yield(id + i % 7);
+	}
+}
+
+void test_coro(const unsigned int& n) {
+	cout << "coro begin" << endl;
+	FibScheduler<> s;
+	vector<int> order;
+	order.reserve(n * 64);
+	for(unsigned int i = 0; i < n; ++i)
+		s.spawn(coro_worker(s, i, 64, order), i);
+	// the frames are allocated at spawn, yields move their embedded nodes only.
+	size_t before = allocations;
+	s.run();
+	assert(allocations == before);
+	assert(order.size() == n * 64 && s.size() == 0);
+	cout << "coro end" << endl;
+}
+#endif
+
 int main(int argc, char* argv[]) {
 	fibonacci_heap::fibonacci_heap<int> fh;
 	unsigned int n = 10;
@@ -82,6 +1125,32 @@ int main(int argc, char* argv[]) {
 
 	// srand(time(0));
 
+	test_prefix_heap(100);
+	test_snapshot(1000);
+	test_timer_queue();
+	test_update_key(200);
+	test_kway_merge(20);
+	test_external_heap(5000);
+	test_graph(300);
+	test_stable_heap(1000);
+	test_typed_heap(100);
+	test_id_queue(500);
+	test_hugepage_heap(500);
+	test_parallel_consolidate(20000);
+	test_ordered_iteration(1000);
+	test_clone(2000);
+	test_erase_if(3000);
+	test_persistent_heap(2000);
+	test_soft_heap(20000);
+	test_adaptive_heap(5000);
+	test_policies(1000);
+	test_trace(2000);
+	test_tuple_heap(3000);
+	test_pop_n(2000);
+#ifdef __cpp_impl_coroutine
+	test_coro(1000);
+#endif
+
 	fill_heaps(fh, pqueue, n);
 	fh.top();
 	assert(match_heaps(fh, pqueue));
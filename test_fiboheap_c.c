@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2014, Emmanuel Benazera beniz@droidnik.fr, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+
+/**
+ * Tests of the C ABI in fiboheap_c.h, built as C so that the header is too.
+ */
+
+#include "fiboheap_c.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int cmp_i64(const void* a, const void* b) {
+	int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static void test_i64(size_t n) {
+	printf("i64 begin\n");
+	fibheap_i64* h = fibheap_i64_create();
+	int64_t* keys = malloc(n * sizeof(int64_t));
+	int64_t* out = malloc(n * sizeof(int64_t));
+	uintptr_t* payloads = malloc(n * sizeof(uintptr_t));
+	fibheap_node** nodes = malloc(n * sizeof(fibheap_node*));
+	size_t i, popped = 0, m;
+	int64_t k;
+	uintptr_t pl;
+	assert(h && keys && out && payloads && nodes);
+	for(i = 0; i < n; ++i) {
+		keys[i] = rand() % 1000;
+		payloads[i] = i;
+	}
+	assert(fibheap_i64_push_n(h, keys, payloads, n, nodes) == n);
+	assert(fibheap_i64_size(h) == n);
+	/* both directions of update_key, then a removal. */
+	fibheap_i64_update_key(h, nodes[n / 2], -1);
+	keys[n / 2] = -1;
+	assert(fibheap_i64_top(h, &k, &pl) && k == -1 && pl == n / 2);
+	fibheap_i64_update_key(h, nodes[n / 2], 5000);
+	keys[n / 2] = 5000;
+	assert(fibheap_i64_top(h, &k, &pl) && k >= 0 && k < 1000);
+	fibheap_i64_remove(h, nodes[0]);
+	keys[0] = keys[n - 1];
+	assert(fibheap_i64_size(h) == n - 1);
+	qsort(keys, n - 1, sizeof(int64_t), cmp_i64);
+	/* uneven batches, the last one short. */
+	while((m = fibheap_i64_pop_n(h, 97, out + popped, payloads)) > 0)
+		popped += m;
+	assert(popped == n - 1 && memcmp(out, keys, popped * sizeof(int64_t)) == 0);
+	assert(out[n - 2] == 5000 && fibheap_i64_size(h) == 0);
+	assert(!fibheap_i64_pop(h, &k, &pl) && fibheap_i64_pop_n(h, 4, out, NULL) == 0);
+	fibheap_i64_destroy(h);
+	free(keys);
+	free(out);
+	free(payloads);
+	free(nodes);
+	printf("i64 end\n");
+}
+
+static void test_f64(void) {
+	printf("f64 begin\n");
+	fibheap_f64* h = fibheap_f64_create();
+	double keys[] = { 2.5, -1.0, 7.25, 0.0 }, out[4];
+	fibheap_node* nodes[4];
+	uintptr_t payloads[4];
+	assert(fibheap_f64_push_n(h, keys, NULL, 4, nodes) == 4);
+	fibheap_f64_update_key(h, nodes[2], -2.0);
+	fibheap_f64_update_key(h, nodes[1], 3.0);
+	fibheap_f64_remove(h, nodes[3]);
+	assert(fibheap_f64_pop_n(h, 8, out, payloads) == 3);
+	assert(out[0] == -2.0 && out[1] == 2.5 && out[2] == 3.0);
+	fibheap_f64_destroy(h);
+	printf("f64 end\n");
+}
+
+static void test_bytes(void) {
+	printf("bytes begin\n");
+	fibheap_bytes* h = fibheap_bytes_create();
+	const char* keys[] = { "bb", "a", "ccc", "a", "zz" };
+	size_t lens[5], len;
+	uintptr_t payloads[5], pl;
+	fibheap_node* nodes[5];
+	char buf[4];
+	size_t i;
+	for(i = 0; i < 5; ++i)
+		lens[i] = strlen(keys[i]);
+	assert(fibheap_bytes_push_n(h, (const void* const*)keys, lens, NULL, 5, nodes) == 5);
+	assert(fibheap_bytes_update_key(h, nodes[4], "b", 1));
+	fibheap_bytes_remove(h, nodes[3]);
+	/* "a" "b" "bb" fill 4 bytes, "ccc" does not fit: its size is reported. */
+	assert(fibheap_bytes_pop_n(h, 5, buf, sizeof(buf), lens, payloads) == 3);
+	assert(memcmp(buf, "abbb", 4) == 0 && lens[0] == 1 && lens[2] == 2 && lens[3] == 3);
+	assert(payloads[0] == 0 && fibheap_bytes_size(h) == 1);
+	/* a buffer too small for the next record pops nothing. */
+	assert(fibheap_bytes_pop_n(h, 5, buf, 2, lens, payloads) == 0 && lens[0] == 3);
+	assert(!fibheap_bytes_pop(h, buf, 2, &len, &pl) && len == 3 && fibheap_bytes_size(h) == 1);
+	assert(fibheap_bytes_pop(h, buf, sizeof(buf), &len, &pl) && len == 3 && memcmp(buf, "ccc", 3) == 0);
+	assert(fibheap_bytes_size(h) == 0);
+	fibheap_bytes_destroy(h);
+	printf("bytes end\n");
+}
+
+int main(void) {
+	assert(fibheap_abi_version() == FIBHEAP_ABI_VERSION);
+	test_i64(5000);
+	test_f64();
+	test_bytes();
+	return 0;
+}